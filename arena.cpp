@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file arena.cpp
+ * \brief File contains the implementation of the bump-pointer arena.
+ * 
+ */
+
+#include "arena.h"
+#include <algorithm>
+
+arena::arena(const std::size_t blockSize) : blockSize(blockSize), currentBlock(0), offset(0), used(0), peak(0)
+{
+}
+
+void* arena::allocate(const std::size_t bytes,const std::size_t alignment)
+{
+    assert((alignment & (alignment - 1)) == 0);
+
+    while(1) {
+        if(this->currentBlock < this->blocks.size()) {
+            // Align the offset inside the current block.
+            std::size_t address = reinterpret_cast<std::size_t>(this->blocks[this->currentBlock].get()) + this->offset;
+            std::size_t padding = (alignment - address % alignment) % alignment;
+            if(this->offset + padding + bytes <= this->blockSizes[this->currentBlock]) {
+                void* memory = this->blocks[this->currentBlock].get() + this->offset + padding;
+                this->offset += padding + bytes;
+                this->used += padding + bytes;
+                this->peak = std::max(this->peak,this->used);
+                return memory;
+            }
+
+            // The current block is full, continue in the next one.
+            this->used += this->blockSizes[this->currentBlock] - this->offset;
+            ++this->currentBlock;
+            this->offset = 0;
+        }
+        else {
+            // All blocks are full, get a new one that is large enough for the request.
+            std::size_t newBlockSize = std::max(this->blockSize,bytes + alignment);
+            this->blocks.push_back(std::unique_ptr<char[]>(new char[newBlockSize]));
+            this->blockSizes.push_back(newBlockSize);
+        }
+    }
+}
+
+arena::marker arena::mark() const
+{
+    marker position;
+    position.block = this->currentBlock;
+    position.offset = this->offset;
+    position.used = this->used;
+    return position;
+}
+
+void arena::rewind(const marker& position)
+{
+    assert(position.used <= this->used);
+    this->currentBlock = position.block;
+    this->offset = position.offset;
+    this->used = position.used;
+}
+
+void arena::reset()
+{
+    this->currentBlock = 0;
+    this->offset = 0;
+    this->used = 0;
+}
+
+std::size_t arena::getUsage() const
+{
+    return this->used;
+}
+
+std::size_t arena::getPeakUsage() const
+{
+    return this->peak;
+}
+
+std::size_t arena::getCapacity() const
+{
+    std::size_t capacity = 0;
+    for(const std::size_t size : this->blockSizes) capacity += size;
+    return capacity;
+}
+
+arena& arena::threadArena()
+{
+    static thread_local arena instance;
+    return instance;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file arena.h
+ * \brief File contains the definition of the bump-pointer arena used for
+ * short-lived search data.
+ * 
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*! \brief Bump-pointer memory arena.
+ *
+ *  Memory is handed out from large blocks by advancing a pointer and is only
+ *  released all at once by reset(), which keeps the blocks for the next use.
+ *  Objects created in the arena are never destroyed, so they have to be
+ *  trivially destructible. An arena must only be used by one thread at a time,
+ *  threadArena() gives every thread its own.
+ */
+class arena
+{
+private:
+    std::size_t blockSize; /*!< The size of a regular block in bytes. */
+    std::vector< std::unique_ptr<char[]> > blocks; /*!< All blocks, reused after reset(). */
+    std::vector<std::size_t> blockSizes; /*!< The size of every block in bytes. */
+    std::size_t currentBlock; /*!< The index of the block that is being filled. */
+    std::size_t offset; /*!< The first free byte in the current block. */
+    std::size_t used; /*!< Bytes handed out since the last reset(), including padding. */
+    std::size_t peak; /*!< The largest value of used ever reached. */
+
+public:
+    /*! \brief Make a new, empty arena.
+     * 
+     *  \param blockSize The size of a regular block in bytes.
+     */
+    arena(const std::size_t blockSize = 1 << 20);
+
+    /*! \brief Allocate uninitialized memory.
+     * 
+     *  \param bytes The number of bytes.
+     *  \param alignment The alignment, a power of two.
+     *  \return The memory, valid until the next reset().
+     */
+    void* allocate(const std::size_t bytes,const std::size_t alignment = alignof(std::max_align_t));
+
+    /*! \brief Allocate an uninitialized array.
+     * 
+     *  \param n The number of elements.
+     *  \return The array, valid until the next reset().
+     */
+    template<class T> T* allocateArray(const std::size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,"Arena objects are never destroyed.");
+        return static_cast<T*>(this->allocate(n*sizeof(T),alignof(T)));
+    }
+
+    /*! \brief Construct an object in the arena.
+     * 
+     *  \param args The constructor arguments.
+     *  \return The object, valid until the next reset().
+     */
+    template<class T,class... Args> T* create(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,"Arena objects are never destroyed.");
+        return new(this->allocate(sizeof(T),alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /*! \brief A position in the arena that later allocations can be rolled back to.
+     *
+     */
+    struct marker
+    {
+        std::size_t block; /*!< The block that was being filled. */
+        std::size_t offset; /*!< The first free byte in that block. */
+        std::size_t used; /*!< The bytes in use. */
+    };
+
+    /*! \brief Remember the current position for rewind().
+     * 
+     *  \return The current position.
+     */
+    marker mark() const;
+
+    /*! \brief Release everything allocated since a call to mark().
+     * 
+     *  Allows stack-like reuse of memory, e.g. by recursive searches.
+     * 
+     *  \param position The position returned by mark().
+     */
+    void rewind(const marker& position);
+
+    /*! \brief Release all allocations at once, keeping the blocks. */
+    void reset();
+
+    /*! \brief Get the bytes handed out since the last reset().
+     * 
+     *  \return The bytes in use.
+     */
+    std::size_t getUsage() const;
+
+    /*! \brief Get the largest number of bytes that were ever in use at once.
+     * 
+     *  \return The peak usage.
+     */
+    std::size_t getPeakUsage() const;
+
+    /*! \brief Get the bytes reserved from the heap.
+     * 
+     *  \return The total size of all blocks.
+     */
+    std::size_t getCapacity() const;
+
+    /*! \brief Get the arena of the calling thread.
+     * 
+     *  \return The arena of the calling thread.
+     */
+    static arena& threadArena();
+};
+
+/*! \brief Standard allocator that takes its memory from an arena.
+ *
+ *  Deallocation is a no-op, the memory is returned by arena::reset().
+ */
+template<class T> class arenaAllocator
+{
+    template<class U> friend class arenaAllocator;
+private:
+    arena* source; /*!< The arena the memory comes from. */
+public:
+    typedef T value_type; /*!< The allocated type. */
+
+    /*! \brief Make a new allocator.
+     * 
+     *  \param source The arena the memory comes from.
+     */
+    arenaAllocator(arena& source) : source(&source)
+    {
+    }
+
+    /*! \brief Make an allocator for another type from the same arena.
+     * 
+     *  \param other The allocator to copy the arena from.
+     */
+    template<class U> arenaAllocator(const arenaAllocator<U>& other) : source(other.source)
+    {
+    }
+
+    /*! \brief Allocate memory for n objects.
+     * 
+     *  \param n The number of objects.
+     *  \return The memory.
+     */
+    T* allocate(const std::size_t n)
+    {
+        return static_cast<T*>(this->source->allocate(n*sizeof(T),alignof(T)));
+    }
+
+    /*! \brief Does nothing, the memory is returned by arena::reset(). */
+    void deallocate(T*,const std::size_t)
+    {
+    }
+
+    /*! \brief Compare the arenas of two allocators. */
+    template<class U> bool operator==(const arenaAllocator<U>& other) const
+    {
+        return this->source == other.source;
+    }
+
+    /*! \brief Compare the arenas of two allocators. */
+    template<class U> bool operator!=(const arenaAllocator<U>& other) const
+    {
+        return this->source != other.source;
+    }
+};
+
+#endif // ARENA_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file batcher.cpp
+ * \brief File contains the implementation of batched move selection.
+ * 
+ */
+
+#include "batcher.h"
+#include <map>
+#include <limits>
+
+void chooseMoves(const std::vector<const board*>& boards,const evaluator& eval,std::vector<char>& moves)
+{
+    const char directions[4] = {UP,DOWN,LEFT,RIGHT};
+
+    // Where the afterstate of one move ended up.
+    struct candidate {
+        unsigned size; // The size of the board, i.e. the batch.
+        unsigned position; // The index in the batch (only for valid moves).
+        unsigned reward; // The merge score of the move.
+        bool isValid; // Whether the move changes the board.
+    };
+    std::vector<candidate> candidates(4*boards.size());
+    std::map<unsigned,positionBatch> batches;
+
+    // Gather the afterstates of all moves into one batch per board size.
+    for(unsigned i = 0; i < boards.size(); ++i) {
+        unsigned size = boards[i]->getSize();
+        positionBatch& batch = batches.insert(std::make_pair(size,positionBatch(size))).first->second;
+        for(unsigned d = 0; d < 4; ++d) {
+            candidate& current = candidates[4*i+d];
+            board afterstate = *boards[i];
+            current.size = size;
+            current.reward = 0;
+            current.isValid = afterstate.move(directions[d],current.reward) != INVALID;
+            if(current.isValid) {
+                current.position = batch.getCount();
+                batch.add(afterstate.getExponents());
+            }
+        }
+    }
+
+    // Evaluate every batch in one pass.
+    std::map<unsigned,std::vector<double> > values;
+    for(auto& batch : batches) eval.evaluateBatch(batch.second,values[batch.first]);
+
+    // Scatter the best move back to every board.
+    moves.assign(boards.size(),QUIT);
+    for(unsigned i = 0; i < boards.size(); ++i) {
+        double bestValue = -std::numeric_limits<double>::infinity();
+        for(unsigned d = 0; d < 4; ++d) {
+            const candidate& current = candidates[4*i+d];
+            if(!current.isValid) continue;
+            double value = current.reward + values[current.size][current.position];
+            if(value > bestValue) {
+                bestValue = value;
+                moves[i] = directions[d];
+            }
+        }
+    }
+}
+
+batchedPolicyInput::batchedPolicyInput(moveBatcher& batcher) : batcher(batcher), owner(NULL), moveReady(false), readyMove(QUIT)
+{
+}
+
+void batchedPolicyInput::attach(session& owner)
+{
+    this->owner = &owner;
+}
+
+bool batchedPolicyInput::nextKey(const board& gameBoard,char& key)
+{
+    // The move is published before the session is woken through the pool, whose
+    // mutex orders the write before this read.
+    if(this->moveReady) {
+        this->moveReady = false;
+        key = this->readyMove;
+        return true;
+    }
+    this->batcher.submit(*this,gameBoard);
+    return false;
+}
+
+moveBatcher::moveBatcher(const evaluator& eval,sessionPool& pool,const unsigned maxBatch,const std::chrono::microseconds maxDelay)
+    : eval(eval), pool(pool), maxBatch(maxBatch), maxDelay(maxDelay), nBatches(0), stopping(false), worker(&moveBatcher::work,this)
+{
+}
+
+moveBatcher::~moveBatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_all();
+    this->worker.join();
+}
+
+void moveBatcher::submit(batchedPolicyInput& input,const board& gameBoard)
+{
+    bool needsNotify;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pendingInputs.push_back(&input);
+        this->pendingBoards.push_back(&gameBoard);
+
+        // The batcher thread only waits for the first board or for a full batch.
+        needsNotify = this->pendingBoards.size() == 1 || this->pendingBoards.size() >= this->maxBatch;
+    }
+    if(needsNotify) this->condition.notify_one();
+}
+
+unsigned long moveBatcher::getBatchCount()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->nBatches;
+}
+
+void moveBatcher::work()
+{
+    std::vector<batchedPolicyInput*> inputs;
+    std::vector<const board*> boards;
+    std::vector<char> moves;
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while(1) {
+        // Wait for the first board, then until the batch is full or the delay has passed.
+        while(this->pendingBoards.empty() && !this->stopping) this->condition.wait(lock);
+        if(this->stopping) return;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + this->maxDelay;
+        while(this->pendingBoards.size() < this->maxBatch && !this->stopping) {
+            if(this->condition.wait_until(lock,deadline) == std::cv_status::timeout) break;
+        }
+        if(this->stopping) return;
+
+        inputs.swap(this->pendingInputs);
+        boards.swap(this->pendingBoards);
+        ++this->nBatches;
+
+        // Evaluate without holding the lock, so that sessions can keep submitting.
+        lock.unlock();
+        chooseMoves(boards,this->eval,moves);
+        for(unsigned i = 0; i < inputs.size(); ++i) {
+            inputs[i]->readyMove = moves[i];
+            inputs[i]->moveReady = true;
+            this->pool.wake(*inputs[i]->owner);
+        }
+        inputs.clear();
+        boards.clear();
+        lock.lock();
+    }
+}
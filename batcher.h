@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file batcher.h
+ * \brief File contains the definition of batched move selection for many
+ * sessions that wait for an AI move.
+ * 
+ */
+
+#ifndef BATCHER_H
+#define BATCHER_H
+
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "board.h"
+#include "evaluator.h"
+#include "session.h"
+
+/*! \brief Choose a move for many boards with one batched evaluation.
+ * 
+ *  The afterstates of all four moves of all boards are gathered into one batch
+ *  per board size and evaluated in one pass. Every board gets the move with the
+ *  best sum of merge score and afterstate value.
+ * 
+ *  \param boards The boards to choose a move for.
+ *  \param eval The evaluator of the afterstates.
+ *  \param moves The chosen move of every board (QUIT if no move is valid).
+ */
+void chooseMoves(const std::vector<const board*>& boards,const evaluator& eval,std::vector<char>& moves);
+
+class moveBatcher;
+
+/*! \brief Input from a moveBatcher.
+ *
+ *  The session suspends while its board waits in the batcher, the batcher
+ *  wakes it once the move has been chosen.
+ */
+class batchedPolicyInput : public inputSource
+{
+    friend class moveBatcher;
+private:
+    moveBatcher& batcher; /*!< The batcher that chooses the moves. */
+    session* owner; /*!< The session that reads from this input. */
+    bool moveReady; /*!< Whether the batcher has chosen the next move. */
+    char readyMove; /*!< The move chosen by the batcher. */
+public:
+    /*! \brief Make a new input.
+     * 
+     *  \param batcher The batcher that chooses the moves.
+     */
+    batchedPolicyInput(moveBatcher& batcher);
+
+    /*! \brief Set the session that reads from this input.
+     * 
+     *  \param owner The session, which has to run in the pool of the batcher.
+     */
+    void attach(session& owner);
+
+    bool nextKey(const board& gameBoard,char& key);
+};
+
+/*! \brief Gathers boards of waiting sessions and chooses their moves in batches.
+ *
+ *  A batch is evaluated once it is full or once its oldest board has waited for
+ *  the maximum delay.
+ */
+class moveBatcher
+{
+private:
+    const evaluator& eval; /*!< The evaluator of the afterstates. */
+    sessionPool& pool; /*!< The pool that runs the sessions. */
+    unsigned maxBatch; /*!< The number of boards that triggers a batch. */
+    std::chrono::microseconds maxDelay; /*!< The longest time a board waits for its batch. */
+    std::mutex mutex; /*!< Protects the pending boards. */
+    std::condition_variable condition; /*!< Signalled when a board is submitted. */
+    std::vector<batchedPolicyInput*> pendingInputs; /*!< The inputs waiting for a move. */
+    std::vector<const board*> pendingBoards; /*!< The boards of the waiting inputs. */
+    unsigned long nBatches; /*!< The number of evaluated batches. */
+    bool stopping; /*!< Whether the batcher thread should exit. */
+    std::thread worker; /*!< The batcher thread. */
+
+    /*! \brief Main loop of the batcher thread. */
+    void work();
+
+public:
+    /*! \brief Make a new batcher and start its thread.
+     * 
+     *  \param eval The evaluator of the afterstates.
+     *  \param pool The pool that runs the sessions.
+     *  \param maxBatch The number of boards that triggers a batch.
+     *  \param maxDelay The longest time a board waits for its batch.
+     */
+    moveBatcher(const evaluator& eval,sessionPool& pool,const unsigned maxBatch = 256,const std::chrono::microseconds maxDelay = std::chrono::microseconds(1000));
+
+    ~moveBatcher(); /*!< Destructor that stops and joins the batcher thread. */
+
+    /*! \brief Queue a board for the next batch.
+     * 
+     *  \param input The input that receives the move.
+     *  \param gameBoard The board, which must not change until the move is delivered.
+     */
+    void submit(batchedPolicyInput& input,const board& gameBoard);
+
+    /*! \brief Get the number of evaluated batches.
+     * 
+     *  \return The number of batches.
+     */
+    unsigned long getBatchCount();
+};
+
+#endif // BATCHER_H
@@ -35,12 +35,14 @@
 #include "board.h"
 #include "helper.h"
 
-board::board(const unsigned size)
+board::board(const unsigned size,const unsigned winTile,const bool continueAfterWin)
 {
     this->size = size;
+    this->winExponent = tileExponent(winTile);
+    this->continueAfterWin = continueAfterWin;
+    this->winReached = false;
 
     // Initialize board with all cells = 0.
-    this->values.resize(this->size);
     this->zero();
 }
 
@@ -50,12 +52,7 @@ board::~board()
 
 void board::zero()
 {
-    for(unsigned i = 0; i < this->size; ++i) {
-        this->values.at(i).resize(this->size);
-        for(unsigned j = 0; j < this->size; ++j) {
-            (*this)(i,j) = 0;
-        }
-    }
+    this->values.assign(this->size*this->size,0);
 }
 
 std::vector< std::tuple<unsigned,unsigned> > board::getEmptyCells()
@@ -83,7 +80,7 @@ bool board::addRandomValue(std::mt19937& mt)
         // If at least one cell is empty...
         
         // ...generate a random number {2,4}...
-        unsigned newValue = generateCellValue(mt);
+        unsigned char newValue = tileExponent(generateCellValue(mt));
 
         // ...get a random empty cell...
         std::uniform_int_distribution<unsigned> randomCellDist(0,emptyCells.size()-1);
@@ -93,7 +90,7 @@ bool board::addRandomValue(std::mt19937& mt)
         // ...and assign the new value.
         unsigned rowId = std::get<0>(cellToModifyId);
         unsigned colId = std::get<1>(cellToModifyId);
-        this->values.at(rowId).at(colId) = newValue;
+        (*this)(rowId,colId) = newValue;
 
         return true;
     }
@@ -101,10 +98,11 @@ bool board::addRandomValue(std::mt19937& mt)
 
 gameState_t board::move(const char direction,unsigned& score) {
     
-    std::vector<unsigned> nonZeroElements;
+    std::vector<unsigned char> nonZeroElements;
     unsigned nZeroElements;
     unsigned nNonZeroElements;
     bool isValidMove = false;
+    bool winTileOnBoard = false;
     
     // Check whether there is still space left on the board.
     bool spaceLeft = false;
@@ -136,8 +134,8 @@ gameState_t board::move(const char direction,unsigned& score) {
             if(combineCells(direction,nonZeroElements,score)) isValidMove = true;
 
             // ...check victory condition and...
-            for(const unsigned elem : nonZeroElements) {
-                if(elem == 2048) return WIN;
+            for(const unsigned char elem : nonZeroElements) {
+                if(elem >= this->winExponent) winTileOnBoard = true;
             }
 
             // ...assign new values to first few cells and set the rest of the line to zero.
@@ -206,6 +204,12 @@ gameState_t board::move(const char direction,unsigned& score) {
             }
         }
     }
+
+    // Report the win once in "continue after win" mode and on every move otherwise.
+    if(winTileOnBoard && (!this->continueAfterWin || !this->winReached)) {
+        this->winReached = true;
+        return WIN;
+    }
     if(isValidMove) {
         return UNFINISHED;
     }
@@ -219,32 +223,36 @@ void board::fillLine(const char direction,std::vector<unsigned> fillVector, cons
     assert(fillVector.size() == this->size);
     switch(direction) {
         case UP:
-            for(unsigned i = 0; i < this->size; ++i) (*this)(lineNumber,i) = fillVector.at(i);
+            for(unsigned i = 0; i < this->size; ++i) (*this)(lineNumber,i) = tileExponent(fillVector.at(i));
             break;
         case DOWN:
             std::reverse(fillVector.begin(), fillVector.end());
-            for(unsigned i = 0; i < this->size; ++i) (*this)(lineNumber,i) = fillVector.at(i);
+            for(unsigned i = 0; i < this->size; ++i) (*this)(lineNumber,i) = tileExponent(fillVector.at(i));
             break;
         case LEFT:
-            for(unsigned i = 0; i < this->size; ++i) (*this)(i,lineNumber) = fillVector.at(i);
+            for(unsigned i = 0; i < this->size; ++i) (*this)(i,lineNumber) = tileExponent(fillVector.at(i));
             break;
         case RIGHT:
             std::reverse(fillVector.begin(), fillVector.end());
-            for(unsigned i = 0; i < this->size; ++i) (*this)(i,lineNumber) = fillVector.at(i);
+            for(unsigned i = 0; i < this->size; ++i) (*this)(i,lineNumber) = tileExponent(fillVector.at(i));
             break;
     }
 }
 
-void board::draw()
+void board::draw() const
 {
-    // Check if the number of rows/columns/cells is valid.
-    assert(this->values.size() == this->size);
-    for(unsigned i = 0; i < this->size; ++i) assert(this->values.at(i).size() == this->size);
+    // Check if the number of cells is valid.
+    assert(this->values.size() == this->size*this->size);
+
+    // Widen the cells if the largest tile does not fit into the default width of 4.
+    unsigned cellWidth = std::max<unsigned>(4,std::to_string(this->getMaxTile()).size());
+    std::string border(cellWidth+2,'=');
+    std::string blank(cellWidth,' ');
 
     // Draw board.
     for(unsigned k = 0; k < this->size; ++k) {
         for(unsigned i = 0; i < this->size; ++i) {
-            std::cout << "======";
+            std::cout << border;
         }
         std::cout << std::endl;
         for(unsigned j = 0; j < 3; ++j) {
@@ -252,31 +260,107 @@ void board::draw()
                 std::cout << "|";
 
                 // If the value of cell i,j is zero do not print the number.
-                if((*this)(i,k) != 0 && j == 1) std::cout << centerNumberstring(4,(*this)(i,k)); else std::cout <<  "    ";
+                if((*this)(i,k) != 0 && j == 1) std::cout << centerNumberstring(cellWidth,tileValue((*this)(i,k))); else std::cout << blank;
                 std::cout <<  "|";
             }
             std::cout << std::endl;
         }
     }
     for(unsigned i = 0; i < this->size; ++i) {
-        std::cout << "======";
+        std::cout << border;
     }
     std::cout << std::endl;
 }
 
 void board::setBoardValues(const std::vector< std::vector< unsigned > > newValues)
 {
-    this->values = newValues;
+    assert(newValues.size() == this->size);
+    for(unsigned i = 0; i < this->size; ++i) {
+        assert(newValues.at(i).size() == this->size);
+        for(unsigned j = 0; j < this->size; ++j) {
+            (*this)(i,j) = tileExponent(newValues.at(i).at(j));
+        }
+    }
 }
 
 std::vector< std::vector<unsigned> > board::getBoardValues() const
+{
+    std::vector< std::vector<unsigned> > boardValues(this->size,std::vector<unsigned>(this->size));
+    for(unsigned i = 0; i < this->size; ++i) {
+        for(unsigned j = 0; j < this->size; ++j) {
+            boardValues.at(i).at(j) = tileValue((*this)(i,j));
+        }
+    }
+    return boardValues;
+}
+
+unsigned board::getSize() const
+{
+    return this->size;
+}
+
+const std::vector<unsigned char>& board::getExponents() const
 {
     return this->values;
 }
 
-unsigned& board::operator()(const unsigned row,const unsigned col)
+void board::setExponents(const std::vector<unsigned char>& newExponents)
+{
+    assert(newExponents.size() == this->size*this->size);
+    this->values = newExponents;
+}
+
+unsigned board::getMaxTile() const
+{
+    unsigned char maxExponent = 0;
+    for(const unsigned char exponent : this->values) maxExponent = std::max(maxExponent,exponent);
+    return tileValue(maxExponent);
+}
+
+unsigned board::getWinTile() const
+{
+    return tileValue(this->winExponent);
+}
+
+bool board::hasWon() const
+{
+    return this->winReached;
+}
+
+void board::setWon(const bool won)
+{
+    this->winReached = won;
+}
+
+void board::write(std::ostream& stream) const
+{
+    writeBinary(stream,(unsigned char)this->size);
+    stream.write(reinterpret_cast<const char*>(this->values.data()),this->values.size());
+    writeBinary(stream,(unsigned char)this->winReached);
+}
+
+bool board::read(std::istream& stream)
+{
+    unsigned char storedSize, storedWin;
+    if(!readBinary(stream,storedSize) || storedSize != this->size) return false;
+    std::vector<unsigned char> storedValues(this->values.size());
+    if(!stream.read(reinterpret_cast<char*>(storedValues.data()),storedValues.size())) return false;
+    if(!readBinary(stream,storedWin)) return false;
+    this->values = storedValues;
+    this->winReached = storedWin != 0;
+    return true;
+}
+
+unsigned char& board::operator()(const unsigned row,const unsigned col)
+{
+    assert(row < this->size);
+    assert(col < this->size);
+    return this->values[row*this->size+col];
+}
+
+unsigned char board::operator()(const unsigned row,const unsigned col) const
 {
     assert(row < this->size);
     assert(col < this->size);
-    return this->values.at(row).at(col);
+    return this->values[row*this->size+col];
 }
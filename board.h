@@ -58,14 +58,17 @@ class board
 {
 private:
     unsigned size; /*!< The number of rows and columns. */
-    std::vector< std::vector<unsigned> > values; /*!< Values of all cells on the Board. First index: rows, second index: columns. */
+    unsigned char winExponent; /*!< Exponent of the tile that wins the game. */
+    bool continueAfterWin; /*!< Whether the game goes on after the win tile has been reached. */
+    bool winReached; /*!< Whether the win tile has already been reported. */
+    std::vector<unsigned char> values; /*!< Base-2 exponents of all cells on the Board (0 = empty), stored row by row. */
 public:
     /*! \brief Draw the board.
      * 
      *  Draw the board to STDOUT.
      * 
      */
-    void draw();
+    void draw() const;
 
     /*! \brief Set all cells to 0.
      * 
@@ -87,6 +90,9 @@ public:
     /*! \brief Make a game move.
      * 
      *  Make a game move: move cell lines and update the board and the score.
+     *  WIN is returned once the win tile is on the board. In "continue after win"
+     *  mode it is only returned by the move that first reaches the win tile, after
+     *  which play goes on normally.
      * 
      * \param direction The direction in which to move the cells.
      * \param score The score that needs updating.
@@ -100,9 +106,11 @@ public:
      *  Constructor for a board of a certain size.
      * 
      * \param size The number of rows and columns on the board.
+     * \param winTile The tile value that wins the game (a power of two).
+     * \param continueAfterWin Whether to keep playing after the win tile was reached.
      * 
      */
-    board(const unsigned size);
+    board(const unsigned size,const unsigned winTile = 2048,const bool continueAfterWin = false);
     
     ~board(); /*!< Destructor that deletes the board object. */
     
@@ -131,6 +139,66 @@ public:
      *  \param newValues The new board values.
      */    
     void setBoardValues(const std::vector< std::vector<unsigned> > newValues);
+
+    /*! \brief Get the number of rows and columns.
+     * 
+     *  \return The size of the board.
+     */    
+    unsigned getSize() const;
+
+    /*! \brief Get the raw cell exponents.
+     * 
+     *  Get the base-2 exponents of all cells (0 = empty), stored row by row, i.e.
+     *  the exponent of cell (row,col) is at index row*size+col.
+     * 
+     *  \return The cell exponents.
+     */    
+    const std::vector<unsigned char>& getExponents() const;
+
+    /*! \brief Set the raw cell exponents.
+     * 
+     *  Inverse of getExponents().
+     * 
+     *  \param newExponents The new cell exponents, stored row by row.
+     */    
+    void setExponents(const std::vector<unsigned char>& newExponents);
+
+    /*! \brief Get the largest tile value on the board.
+     * 
+     *  \return The largest tile value, or 0 for an empty board.
+     */    
+    unsigned getMaxTile() const;
+
+    /*! \brief Get the tile value that wins the game.
+     * 
+     *  \return The win tile value.
+     */    
+    unsigned getWinTile() const;
+
+    /*! \brief Check whether the win tile has been reached.
+     * 
+     *  \return Whether a move has already reported WIN.
+     */    
+    bool hasWon() const;
+
+    /*! \brief Set whether the win tile has been reached (to take back a move).
+     * 
+     *  \param won Whether a move has already reported WIN.
+     */    
+    void setWon(const bool won);
+
+    /*! \brief Write the cells and the win flag in a compact binary form.
+     * 
+     *  \param stream The output stream.
+     */    
+    void write(std::ostream& stream) const;
+
+    /*! \brief Read a board written by write().
+     * 
+     *  \param stream The input stream.
+     *  \return Whether a board of the same size was read.
+     */    
+    bool read(std::istream& stream);
     
     /*! \brief Get board values.
      * 
@@ -144,14 +212,24 @@ public:
      * 
      *  Overloaded function call operator for matrix element access allows simple idiomatic
      *  access to board matrix elements via (*this)(X,Y) in member function and [board instance](X,Y)
-     *  otherwise.
+     *  otherwise. The elements are the base-2 exponents of the tiles (0 = empty), use
+     *  tileValue() to get the tile value.
      * 
      *  \param row The number of the row (X) to access.
      *  \param col The number of the column (Y) to access.
      *  \return The address of a board matrix element.
      * 
      */    
-    unsigned& operator()(const unsigned row,const unsigned col);
+    unsigned char& operator()(const unsigned row,const unsigned col);
+
+    /*! \brief Read-only matrix element access.
+     * 
+     *  \param row The number of the row (X) to access.
+     *  \param col The number of the column (Y) to access.
+     *  \return The exponent of a board matrix element.
+     * 
+     */    
+    unsigned char operator()(const unsigned row,const unsigned col) const;
     
 };
 
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file cache.cpp
+ * \brief File contains the implementation of the transposition table.
+ * 
+ */
+
+#include "cache.h"
+
+// Round up to the next power of two.
+static std::size_t roundUpPowerOfTwo(const std::size_t n)
+{
+    std::size_t result = 1;
+    while(result < n) result <<= 1;
+    return result;
+}
+
+transpositionTable::transpositionTable(const std::size_t nEntries,const unsigned nLocks)
+    : entries(roundUpPowerOfTwo(nEntries)), locks(roundUpPowerOfTwo(nLocks)), nLookups(0), nHits(0)
+{
+    this->clear();
+}
+
+uint64_t transpositionTable::hashPosition(const unsigned char* cells,const unsigned size)
+{
+    // FNV-1a over the board size and all cell exponents.
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ size) * 1099511628211ULL;
+    for(unsigned i = 0; i < size*size; ++i) hash = (hash ^ cells[i]) * 1099511628211ULL;
+    // 0 marks empty slots. Remapping only that hash keeps the low bits, which pick the slot, intact.
+    return hash == 0 ? 1 : hash;
+}
+
+bool transpositionTable::lookup(const uint64_t key,const unsigned depth,double& value)
+{
+    this->nLookups.fetch_add(1,std::memory_order_relaxed);
+    std::size_t slot = key & (this->entries.size() - 1);
+    std::lock_guard<std::mutex> lock(this->locks[slot & (this->locks.size() - 1)]);
+    const entry& current = this->entries[slot];
+    // A value searched deeper than needed is at least as good.
+    if(current.key != key || current.depth < depth) return false;
+    value = current.value;
+    this->nHits.fetch_add(1,std::memory_order_relaxed);
+    return true;
+}
+
+void transpositionTable::store(const uint64_t key,const unsigned depth,const double value)
+{
+    std::size_t slot = key & (this->entries.size() - 1);
+    std::lock_guard<std::mutex> lock(this->locks[slot & (this->locks.size() - 1)]);
+    entry& current = this->entries[slot];
+    // Keep a deeper value of the same position.
+    if(current.key == key && current.depth > depth) return;
+    current.key = key;
+    current.value = value;
+    current.depth = depth;
+}
+
+void transpositionTable::clear()
+{
+    for(std::size_t i = 0; i < this->entries.size(); ++i) {
+        std::lock_guard<std::mutex> lock(this->locks[i & (this->locks.size() - 1)]);
+        this->entries[i].key = 0;
+    }
+    this->nLookups = 0;
+    this->nHits = 0;
+}
+
+unsigned long transpositionTable::getLookupCount() const
+{
+    return this->nLookups;
+}
+
+unsigned long transpositionTable::getHitCount() const
+{
+    return this->nHits;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file cache.h
+ * \brief File contains the definition of the transposition table that search
+ * threads share to reuse values of positions they have already searched.
+ * 
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*! \brief Fixed-size, thread-safe cache of searched position values.
+ *
+ *  Every position hashes to one slot, newer values replace older ones. Slots
+ *  are protected by a smaller number of striped locks.
+ */
+class transpositionTable
+{
+private:
+    /*! \brief One cached value.
+     *
+     */
+    struct entry
+    {
+        uint64_t key; /*!< The position hash (0 = empty slot). */
+        double value; /*!< The value of the position. */
+        unsigned depth; /*!< The search depth of the value. */
+    };
+
+    std::vector<entry> entries; /*!< The slots, a power of two. */
+    std::vector<std::mutex> locks; /*!< The striped locks, a power of two. */
+    std::atomic<unsigned long> nLookups; /*!< The number of lookups. */
+    std::atomic<unsigned long> nHits; /*!< The number of successful lookups. */
+
+public:
+    /*! \brief Make a new, empty table.
+     * 
+     *  \param nEntries The number of slots, rounded up to a power of two.
+     *  \param nLocks The number of locks, rounded up to a power of two.
+     */
+    transpositionTable(const std::size_t nEntries = 1 << 20,const unsigned nLocks = 1024);
+
+    /*! \brief Hash a position.
+     * 
+     *  \param cells The size*size cell exponents of the position.
+     *  \param size The number of rows and columns.
+     *  \return A non-zero 64 bit hash, whose low bits select the slot.
+     */
+    static uint64_t hashPosition(const unsigned char* cells,const unsigned size);
+
+    /*! \brief Look up the value of a position.
+     * 
+     *  \param key The position hash.
+     *  \param depth The least search depth the value must have been computed with.
+     *  \param value The cached value, if found.
+     *  \return Whether the value was found.
+     */
+    bool lookup(const uint64_t key,const unsigned depth,double& value);
+
+    /*! \brief Store the value of a position.
+     * 
+     *  A deeper value of the same position is kept.
+     * 
+     *  \param key The position hash.
+     *  \param depth The search depth of the value.
+     *  \param value The value.
+     */
+    void store(const uint64_t key,const unsigned depth,const double value);
+
+    /*! \brief Remove all values and reset the statistics. */
+    void clear();
+
+    /*! \brief Get the number of lookups since the last clear().
+     * 
+     *  \return The number of lookups.
+     */
+    unsigned long getLookupCount() const;
+
+    /*! \brief Get the number of successful lookups since the last clear().
+     * 
+     *  \return The number of hits.
+     */
+    unsigned long getHitCount() const;
+};
+
+#endif // CACHE_H
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file dataset.cpp
+ * \brief File contains the implementation of the sharded columnar training
+ * dataset writer and its memory-mapped reader.
+ * 
+ */
+
+#include "dataset.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*! \brief Header of a dataset shard file.
+ *
+ */
+struct datasetHeader
+{
+    char magic[8]; /*!< "G2048DS" and a terminating zero. */
+    uint32_t version; /*!< The file format version. */
+    uint32_t boardSize; /*!< The number of rows and columns of the positions. */
+    uint32_t positionBytes; /*!< The size of one position, one byte per cell. */
+    uint32_t reserved; /*!< Always 0. */
+    uint64_t nRows; /*!< The number of rows. */
+    uint64_t columnOffsets[DATASET_COLUMNS]; /*!< The file offset of every column. */
+};
+
+static const char datasetMagic[8] = "G2048DS";
+
+/*! \brief The number of rows written at once. */
+static const uint64_t chunkRows = 4096;
+
+/*! \brief Get the size of a column entry.
+ * 
+ *  \param column The column.
+ *  \param positionBytes The size of one packed position.
+ *  \return The number of bytes per row.
+ */
+static unsigned columnWidth(const unsigned column,const unsigned positionBytes)
+{
+    switch(column) {
+        case DATASET_POSITIONS:
+            return positionBytes;
+        case DATASET_MOVES:
+            return 1;
+        case DATASET_FINAL_SCORES:
+            return sizeof(uint32_t);
+        default:
+            return sizeof(float);
+    }
+}
+
+/*! \brief Compute the column offsets of a shard.
+ * 
+ *  \param nRows The number of rows the columns have space for.
+ *  \param positionBytes The size of one packed position.
+ *  \param offsets Receives the offsets.
+ *  \return The size of the file.
+ */
+static uint64_t layoutColumns(const uint64_t nRows,const unsigned positionBytes,uint64_t* offsets)
+{
+    uint64_t offset = sizeof(datasetHeader);
+    for(unsigned i = 0; i < DATASET_COLUMNS; ++i) {
+        offset = (offset+63)/64*64;
+        offsets[i] = offset;
+        offset += nRows*columnWidth(i,positionBytes);
+    }
+    return offset;
+}
+
+/*! \brief Write a whole buffer at a file offset.
+ * 
+ *  \param fd The file.
+ *  \param data The buffer.
+ *  \param bytes The size of the buffer.
+ *  \param offset The file offset.
+ *  \return Whether everything was written.
+ */
+static bool writeAt(const int fd,const void* data,std::size_t bytes,off_t offset)
+{
+    const char* remaining = static_cast<const char*>(data);
+    while(bytes > 0) {
+        ssize_t written = pwrite(fd,remaining,bytes,offset);
+        if(written <= 0) return false;
+        remaining += written;
+        bytes -= written;
+        offset += written;
+    }
+    return true;
+}
+
+datasetWriter::datasetWriter(const std::string& prefix,const unsigned boardSize,const uint64_t rowsPerShard)
+    : prefix(prefix), boardSize(boardSize), positionBytes(boardSize*boardSize), rowsPerShard(rowsPerShard),
+      fd(-1), nShards(0), shardRows(0), nRows(0), failed(false)
+{
+    assert(rowsPerShard > 0);
+}
+
+datasetWriter::~datasetWriter()
+{
+    this->close();
+}
+
+void datasetWriter::addMove(const unsigned char* cells,const char move,const unsigned score)
+{
+    this->gamePositions.insert(this->gamePositions.end(),cells,cells+this->positionBytes);
+    this->gameMoves.push_back(move);
+    this->gameScores.push_back(score);
+}
+
+bool datasetWriter::endGame(const unsigned finalScore)
+{
+    for(size_t i = 0; i < this->gameMoves.size(); ++i) {
+        uint32_t finalScoreEntry = finalScore;
+        float valueTarget = float(finalScore - this->gameScores[i]);
+        const unsigned char* position = &this->gamePositions[i*this->positionBytes];
+        this->chunk[DATASET_POSITIONS].insert(this->chunk[DATASET_POSITIONS].end(),position,position+this->positionBytes);
+        this->chunk[DATASET_MOVES].push_back(this->gameMoves[i]);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&finalScoreEntry);
+        this->chunk[DATASET_FINAL_SCORES].insert(this->chunk[DATASET_FINAL_SCORES].end(),bytes,bytes+sizeof(finalScoreEntry));
+        bytes = reinterpret_cast<const unsigned char*>(&valueTarget);
+        this->chunk[DATASET_VALUE_TARGETS].insert(this->chunk[DATASET_VALUE_TARGETS].end(),bytes,bytes+sizeof(valueTarget));
+        ++this->nRows;
+
+        // Write full chunks, and never more rows than the current shard has space for.
+        uint64_t waiting = this->chunk[DATASET_MOVES].size();
+        if(waiting == chunkRows || this->shardRows + waiting == this->rowsPerShard) {
+            if(!this->flush()) this->failed = true;
+        }
+    }
+    this->discardGame();
+    return !this->failed;
+}
+
+void datasetWriter::discardGame()
+{
+    this->gamePositions.clear();
+    this->gameMoves.clear();
+    this->gameScores.clear();
+}
+
+bool datasetWriter::flush()
+{
+    uint64_t waiting = this->chunk[DATASET_MOVES].size();
+    if(waiting == 0) return true;
+
+    if(this->fd < 0) {
+        std::string path = shardPath(this->prefix,this->nShards);
+        this->fd = ::open(path.c_str(),O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,0644);
+        if(this->fd < 0) {
+            std::cerr << "Cannot create the dataset shard " << path << "." << std::endl;
+            for(unsigned i = 0; i < DATASET_COLUMNS; ++i) this->chunk[i].clear();
+            return false;
+        }
+        ++this->nShards;
+        this->shardRows = 0;
+        layoutColumns(this->rowsPerShard,this->positionBytes,this->columnOffsets);
+    }
+
+    bool written = true;
+    for(unsigned i = 0; i < DATASET_COLUMNS; ++i) {
+        off_t offset = this->columnOffsets[i] + this->shardRows*columnWidth(i,this->positionBytes);
+        written = writeAt(this->fd,this->chunk[i].data(),this->chunk[i].size(),offset) && written;
+        this->chunk[i].clear();
+    }
+    this->shardRows += waiting;
+    if(this->shardRows == this->rowsPerShard) written = this->finishShard() && written;
+    return written;
+}
+
+bool datasetWriter::finishShard()
+{
+    if(this->fd < 0) return true;
+
+    // Move the columns of a partial shard together, forward copies never overwrite unread data.
+    uint64_t offsets[DATASET_COLUMNS];
+    uint64_t fileSize = layoutColumns(this->shardRows,this->positionBytes,offsets);
+    bool written = true;
+    std::vector<char> buffer(1 << 16);
+    for(unsigned i = 1; i < DATASET_COLUMNS && this->shardRows < this->rowsPerShard; ++i) {
+        uint64_t bytes = this->shardRows*columnWidth(i,this->positionBytes);
+        for(uint64_t done = 0; done < bytes; done += buffer.size()) {
+            std::size_t length = std::min<uint64_t>(buffer.size(),bytes-done);
+            if(pread(this->fd,buffer.data(),length,this->columnOffsets[i]+done) != ssize_t(length)) written = false;
+            if(!writeAt(this->fd,buffer.data(),length,offsets[i]+done)) written = false;
+        }
+    }
+
+    datasetHeader header;
+    std::memset(&header,0,sizeof(header));
+    std::memcpy(header.magic,datasetMagic,sizeof(header.magic));
+    header.version = 2;
+    header.boardSize = this->boardSize;
+    header.positionBytes = this->positionBytes;
+    header.nRows = this->shardRows;
+    std::memcpy(header.columnOffsets,offsets,sizeof(offsets));
+    if(!writeAt(this->fd,&header,sizeof(header),0) || ftruncate(this->fd,fileSize) != 0) written = false;
+    if(::close(this->fd) != 0) written = false;
+    this->fd = -1;
+    this->shardRows = 0;
+    if(!written) std::cerr << "Cannot write the dataset shard " << shardPath(this->prefix,this->nShards-1) << "." << std::endl;
+    return written;
+}
+
+bool datasetWriter::close()
+{
+    this->discardGame();
+    if(!this->flush()) this->failed = true;
+    if(!this->finishShard()) this->failed = true;
+    return !this->failed;
+}
+
+unsigned datasetWriter::getShardCount() const
+{
+    return this->nShards;
+}
+
+uint64_t datasetWriter::getRowCount() const
+{
+    return this->nRows;
+}
+
+std::string datasetWriter::shardPath(const std::string& prefix,const unsigned shard)
+{
+    char number[16];
+    std::snprintf(number,sizeof(number),"%05u",shard);
+    return prefix + "-" + number + ".g2048ds";
+}
+
+datasetShard::datasetShard() : boardSize(0), positionBytes(0), nRows(0), mapping(NULL), mappingSize(0)
+{
+    for(unsigned i = 0; i < DATASET_COLUMNS; ++i) this->columns[i] = NULL;
+}
+
+datasetShard::~datasetShard()
+{
+    if(this->mapping) munmap(this->mapping,this->mappingSize);
+}
+
+bool datasetShard::open(const std::string& path)
+{
+    if(this->mapping) munmap(this->mapping,this->mappingSize);
+    this->mapping = NULL;
+    this->nRows = 0;
+
+    int fd = ::open(path.c_str(),O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    struct stat status;
+    if(fstat(fd,&status) < 0 || std::size_t(status.st_size) < sizeof(datasetHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL,status.st_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if(mapping == MAP_FAILED) return false;
+
+    // Check the header before using the columns.
+    const datasetHeader* header = static_cast<const datasetHeader*>(mapping);
+    uint64_t offsets[DATASET_COLUMNS];
+    if(std::memcmp(header->magic,datasetMagic,sizeof(header->magic)) != 0 || header->version != 2
+       || header->boardSize < 2 || header->positionBytes != header->boardSize*header->boardSize
+       || layoutColumns(header->nRows,header->positionBytes,offsets) != uint64_t(status.st_size)
+       || std::memcmp(offsets,header->columnOffsets,sizeof(offsets)) != 0) {
+        munmap(mapping,status.st_size);
+        return false;
+    }
+    this->mapping = mapping;
+    this->mappingSize = status.st_size;
+    this->boardSize = header->boardSize;
+    this->positionBytes = header->positionBytes;
+    this->nRows = header->nRows;
+    for(unsigned i = 0; i < DATASET_COLUMNS; ++i) this->columns[i] = static_cast<const unsigned char*>(mapping) + offsets[i];
+    return true;
+}
+
+uint64_t datasetShard::getRowCount() const
+{
+    return this->nRows;
+}
+
+unsigned datasetShard::getBoardSize() const
+{
+    return this->boardSize;
+}
+
+unsigned datasetShard::getPositionBytes() const
+{
+    return this->positionBytes;
+}
+
+const unsigned char* datasetShard::getPositions() const
+{
+    return this->columns[DATASET_POSITIONS];
+}
+
+const unsigned char* datasetShard::getMoves() const
+{
+    return this->columns[DATASET_MOVES];
+}
+
+const uint32_t* datasetShard::getFinalScores() const
+{
+    return reinterpret_cast<const uint32_t*>(this->columns[DATASET_FINAL_SCORES]);
+}
+
+const float* datasetShard::getValueTargets() const
+{
+    return reinterpret_cast<const float*>(this->columns[DATASET_VALUE_TARGETS]);
+}
+
+void datasetShard::getPosition(const uint64_t row,unsigned char* cells) const
+{
+    assert(row < this->nRows);
+    const unsigned char* position = this->columns[DATASET_POSITIONS] + row*this->positionBytes;
+    std::copy(position,position+this->positionBytes,cells);
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file dataset.h
+ * \brief File contains the definition of the sharded columnar training dataset
+ * writer and its memory-mapped reader.
+ * 
+ */
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*! \brief The columns of a dataset shard. */
+enum datasetColumn_t { DATASET_POSITIONS, DATASET_MOVES, DATASET_FINAL_SCORES, DATASET_VALUE_TARGETS, DATASET_COLUMNS };
+
+/*! \brief Writes (position, move, final score, value target) rows into shard files.
+ *
+ *  Every shard file is a fixed header followed by one column per field, each
+ *  column starting at a 64 byte aligned offset:
+ *  - positions: the cell exponents in row-major order, one byte per cell, so
+ *    that positions with tiles above 32768 are stored exactly.
+ *  - moves: the command key (UP, DOWN, LEFT or RIGHT) as one byte.
+ *  - final scores: the score at the end of the game as uint32.
+ *  - value targets: the score still gained from the position to the end of
+ *    the game as float.
+ *
+ *  The rows of a game are kept until its final score is known, all other rows
+ *  are written in chunks, so the memory does not grow with the dataset. A shard
+ *  is completed when it holds rowsPerShard rows, the last one is shrunk by close().
+ */
+class datasetWriter
+{
+private:
+    std::string prefix; /*!< Shard i is written to prefix-i.g2048ds (i with 5 digits). */
+    unsigned boardSize; /*!< The number of rows and columns of the positions. */
+    unsigned positionBytes; /*!< The size of one position. */
+    uint64_t rowsPerShard; /*!< The number of rows of a complete shard. */
+    int fd; /*!< The current shard file (-1 if none is open). */
+    unsigned nShards; /*!< The number of started shards. */
+    uint64_t shardRows; /*!< The number of rows written into the current shard. */
+    uint64_t nRows; /*!< The number of rows of all shards. */
+    uint64_t columnOffsets[DATASET_COLUMNS]; /*!< The column offsets of the current shard. */
+    bool failed; /*!< Whether writing failed. */
+    std::vector<unsigned char> gamePositions; /*!< The positions of the game in progress. */
+    std::vector<unsigned char> gameMoves; /*!< The moves of the game in progress. */
+    std::vector<uint32_t> gameScores; /*!< The scores before the moves of the game in progress. */
+    std::vector<unsigned char> chunk[DATASET_COLUMNS]; /*!< Rows waiting to be written. */
+
+    /*! \brief Write the waiting rows into the current shard, start a shard if needed.
+     * 
+     *  \return Whether the rows were written.
+     */
+    bool flush();
+
+    /*! \brief Write the header of the current shard and close it.
+     * 
+     *  \return Whether the shard was completed.
+     */
+    bool finishShard();
+
+public:
+    /*! \brief Make a writer, the first shard is created with the first row.
+     * 
+     *  \param prefix The path prefix of the shard files.
+     *  \param boardSize The number of rows and columns of the positions.
+     *  \param rowsPerShard The number of rows of a complete shard.
+     */
+    datasetWriter(const std::string& prefix,const unsigned boardSize,const uint64_t rowsPerShard = 1 << 20);
+
+    ~datasetWriter(); /*!< Destructor that closes the writer. */
+
+    /*! \brief Add a move of the game in progress.
+     * 
+     *  \param cells The cell exponents before the move, stored row by row.
+     *  \param move The command key of the move.
+     *  \param score The score before the move.
+     */
+    void addMove(const unsigned char* cells,const char move,const unsigned score);
+
+    /*! \brief Finish the game in progress and queue its rows for writing.
+     * 
+     *  \param finalScore The score at the end of the game.
+     *  \return Whether all rows so far were written.
+     */
+    bool endGame(const unsigned finalScore);
+
+    /*! \brief Drop the moves of the game in progress. */
+    void discardGame();
+
+    /*! \brief Write all finished games and complete the last shard.
+     * 
+     *  \return Whether all rows were written.
+     */
+    bool close();
+
+    /*! \brief Get the number of shard files.
+     * 
+     *  \return The number of shards.
+     */
+    unsigned getShardCount() const;
+
+    /*! \brief Get the number of rows of all finished games.
+     * 
+     *  \return The number of rows.
+     */
+    uint64_t getRowCount() const;
+
+    /*! \brief Get the path of a shard file.
+     * 
+     *  \param prefix The path prefix of the shard files.
+     *  \param shard The index of the shard.
+     *  \return The path.
+     */
+    static std::string shardPath(const std::string& prefix,const unsigned shard);
+};
+
+/*! \brief A memory-mapped shard written by datasetWriter.
+ *
+ *  The columns are returned as pointers into the mapping without copying.
+ */
+class datasetShard
+{
+private:
+    unsigned boardSize; /*!< The number of rows and columns of the positions. */
+    unsigned positionBytes; /*!< The size of one position. */
+    uint64_t nRows; /*!< The number of rows. */
+    const unsigned char* columns[DATASET_COLUMNS]; /*!< The columns inside the mapping. */
+    void* mapping; /*!< The memory-mapped file (NULL if none is open). */
+    std::size_t mappingSize; /*!< The size of the mapping in bytes. */
+
+public:
+    datasetShard(); /*!< Make an empty shard. */
+
+    ~datasetShard(); /*!< Destructor that unmaps the file. */
+
+    /*! \brief Map a shard file.
+     * 
+     *  \param path The file path.
+     *  \return Whether the file is a valid shard.
+     */
+    bool open(const std::string& path);
+
+    /*! \brief Get the number of rows.
+     * 
+     *  \return The number of rows.
+     */
+    uint64_t getRowCount() const;
+
+    /*! \brief Get the number of rows and columns of the positions.
+     * 
+     *  \return The board size.
+     */
+    unsigned getBoardSize() const;
+
+    /*! \brief Get the size of one position.
+     * 
+     *  \return The number of bytes.
+     */
+    unsigned getPositionBytes() const;
+
+    /*! \brief Get the positions, getPositionBytes() cell exponents per row.
+     * 
+     *  \return The position column.
+     */
+    const unsigned char* getPositions() const;
+
+    /*! \brief Get the moves.
+     * 
+     *  \return The move column.
+     */
+    const unsigned char* getMoves() const;
+
+    /*! \brief Get the final scores.
+     * 
+     *  \return The final score column.
+     */
+    const uint32_t* getFinalScores() const;
+
+    /*! \brief Get the value targets.
+     * 
+     *  \return The value target column.
+     */
+    const float* getValueTargets() const;
+
+    /*! \brief Copy the position of a row.
+     * 
+     *  \param row The row.
+     *  \param cells Receives the cell exponents, stored row by row.
+     */
+    void getPosition(const uint64_t row,unsigned char* cells) const;
+};
+
+#endif // DATASET_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file evaluator.cpp
+ * \brief File contains the implementation of position evaluators and position
+ * batches.
+ * 
+ */
+
+#include "evaluator.h"
+
+positionBatch::positionBatch(const unsigned size) : size(size)
+{
+}
+
+void positionBatch::clear()
+{
+    this->cells.clear();
+}
+
+void positionBatch::add(const std::vector<unsigned char>& exponents)
+{
+    assert(exponents.size() == this->size*this->size);
+    this->cells.insert(this->cells.end(),exponents.begin(),exponents.end());
+}
+
+unsigned positionBatch::getSize() const
+{
+    return this->size;
+}
+
+unsigned positionBatch::getCount() const
+{
+    return this->cells.size()/(this->size*this->size);
+}
+
+const unsigned char* positionBatch::getPosition(const unsigned i) const
+{
+    assert(i < this->getCount());
+    return this->cells.data() + i*this->size*this->size;
+}
+
+evaluator::~evaluator()
+{
+}
+
+void evaluator::evaluateBatch(const positionBatch& batch,std::vector<double>& values) const
+{
+    values.resize(batch.getCount());
+    for(unsigned i = 0; i < batch.getCount(); ++i) values[i] = this->evaluate(batch.getPosition(i),batch.getSize());
+}
+
+heuristicWeights::heuristicWeights() : empty(270.0), merges(700.0), monotonicity(47.0), corner(10.0)
+{
+}
+
+heuristicEvaluator::heuristicEvaluator(const heuristicWeights& weights) : weights(weights)
+{
+}
+
+double heuristicEvaluator::evaluateLine(const unsigned char* line,const unsigned stride,const unsigned length) const
+{
+    unsigned nEmpty = 0;
+    unsigned nMerges = 0;
+    unsigned increases = 0;
+    unsigned decreases = 0;
+    unsigned char previous = 0;
+    for(unsigned i = 0; i < length; ++i) {
+        unsigned char exponent = line[i*stride];
+        if(exponent == 0) {
+            ++nEmpty;
+        }
+        else {
+            // Count equal neighbours, ignoring empty cells in between.
+            if(exponent == previous) ++nMerges;
+            previous = exponent;
+        }
+        if(i > 0) {
+            unsigned char left = line[(i-1)*stride];
+            if(exponent > left) increases += exponent - left; else decreases += left - exponent;
+        }
+    }
+    unsigned char ends = std::max(line[0],line[(length-1)*stride]);
+
+    return this->weights.empty*nEmpty + this->weights.merges*nMerges
+        - this->weights.monotonicity*std::min(increases,decreases) + this->weights.corner*ends;
+}
+
+double heuristicEvaluator::evaluate(const unsigned char* cells,const unsigned size) const
+{
+    double value = 0.0;
+    for(unsigned i = 0; i < size; ++i) {
+        value += this->evaluateLine(cells + i*size,1,size); // Row i.
+        value += this->evaluateLine(cells + i,size,size); // Column i.
+    }
+    return value;
+}
+
+tableEvaluator::tableEvaluator(const heuristicWeights& weights) : heuristicEvaluator(weights), lineScores(65536)
+{
+    unsigned char line[4];
+    for(unsigned index = 0; index < 65536; ++index) {
+        for(unsigned k = 0; k < 4; ++k) line[k] = (index >> (4*k)) & 0xf;
+        this->lineScores[index] = this->evaluateLine(line,1,4);
+    }
+}
+
+double tableEvaluator::evaluatePacked(const packedBoard packed) const
+{
+    packedBoard transposed = transposePacked(packed);
+    double value = 0.0;
+    for(unsigned i = 0; i < 4; ++i) {
+        value += this->lineScores[(packed >> (16*i)) & 0xffff]; // Row i.
+        value += this->lineScores[(transposed >> (16*i)) & 0xffff]; // Column i.
+    }
+    return value;
+}
+
+double tableEvaluator::evaluate(const unsigned char* cells,const unsigned size) const
+{
+    packedBoard packed;
+    if(size != 4 || !packBoard(cells,packed)) return this->heuristicEvaluator::evaluate(cells,size);
+    return this->evaluatePacked(packed);
+}
+
+ntupleEvaluator::ntupleEvaluator(const std::vector< std::vector<unsigned> >& tuples) : tuples(tuples)
+{
+    for(const std::vector<unsigned>& tuple : this->tuples) {
+        assert(tuple.size() > 0 && tuple.size() <= 6);
+        this->weights.push_back(std::vector<float>(1u << (4*tuple.size()),0.0f));
+    }
+}
+
+std::vector< std::vector<unsigned> > ntupleEvaluator::lineTuples(const unsigned size)
+{
+    assert(size <= 6);
+    std::vector< std::vector<unsigned> > lines;
+    for(unsigned i = 0; i < size; ++i) {
+        std::vector<unsigned> rowCells,colCells;
+        for(unsigned j = 0; j < size; ++j) {
+            rowCells.push_back(i*size+j);
+            colCells.push_back(j*size+i);
+        }
+        lines.push_back(rowCells);
+        lines.push_back(colCells);
+    }
+    return lines;
+}
+
+std::vector<float>& ntupleEvaluator::getWeights(const unsigned tuple)
+{
+    return this->weights.at(tuple);
+}
+
+unsigned ntupleEvaluator::tupleIndex(const unsigned tuple,const unsigned char* cells) const
+{
+    const std::vector<unsigned>& cellIds = this->tuples[tuple];
+    unsigned index = 0;
+    for(unsigned i = 0; i < cellIds.size(); ++i) {
+        unsigned exponent = std::min<unsigned>(cells[cellIds[i]],15);
+        index |= exponent << (4*i);
+    }
+    return index;
+}
+
+double ntupleEvaluator::evaluate(const unsigned char* cells,const unsigned size) const
+{
+    double value = 0.0;
+    for(unsigned t = 0; t < this->tuples.size(); ++t) value += this->weights[t][this->tupleIndex(t,cells)];
+    return value;
+}
+
+void ntupleEvaluator::evaluateBatch(const positionBatch& batch,std::vector<double>& values) const
+{
+    values.assign(batch.getCount(),0.0);
+
+    // Tuple-major order keeps one weight table hot for the whole batch.
+    for(unsigned t = 0; t < this->tuples.size(); ++t) {
+        const std::vector<float>& table = this->weights[t];
+        for(unsigned i = 0; i < batch.getCount(); ++i) values[i] += table[this->tupleIndex(t,batch.getPosition(i))];
+    }
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file evaluator.h
+ * \brief File contains the definition of position evaluators and of batches of
+ * positions that are evaluated in one pass.
+ * 
+ */
+
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <vector>
+#include "board.h"
+#include "helper.h"
+#include "packed.h"
+
+/*! \brief Positions of one board size stored back to back.
+ *
+ *  Position i occupies the cell exponents [i*size*size, (i+1)*size*size), in the
+ *  same row-major layout as board::getExponents().
+ */
+class positionBatch
+{
+private:
+    unsigned size; /*!< The number of rows and columns of every position. */
+    std::vector<unsigned char> cells; /*!< The cell exponents of all positions. */
+public:
+    /*! \brief Make a new, empty batch.
+     * 
+     *  \param size The number of rows and columns of every position.
+     */
+    positionBatch(const unsigned size);
+
+    /*! \brief Remove all positions but keep the memory. */
+    void clear();
+
+    /*! \brief Append a position.
+     * 
+     *  \param exponents The cell exponents of the position, stored row by row.
+     */
+    void add(const std::vector<unsigned char>& exponents);
+
+    /*! \brief Get the number of rows and columns of every position.
+     * 
+     *  \return The board size.
+     */
+    unsigned getSize() const;
+
+    /*! \brief Get the number of positions.
+     * 
+     *  \return The number of positions.
+     */
+    unsigned getCount() const;
+
+    /*! \brief Get the cell exponents of a position.
+     * 
+     *  \param i The index of the position.
+     *  \return A pointer to the size*size exponents of the position.
+     */
+    const unsigned char* getPosition(const unsigned i) const;
+};
+
+/*! \brief Scores positions, higher is better.
+ *
+ */
+class evaluator
+{
+public:
+    virtual ~evaluator(); /*!< Destructor. */
+
+    /*! \brief Evaluate a single position.
+     * 
+     *  \param cells The size*size cell exponents of the position, stored row by row.
+     *  \param size The number of rows and columns.
+     *  \return The value of the position.
+     */
+    virtual double evaluate(const unsigned char* cells,const unsigned size) const = 0;
+
+    /*! \brief Evaluate all positions of a batch.
+     * 
+     *  The default implementation evaluates the positions one by one.
+     * 
+     *  \param batch The positions.
+     *  \param values The values, resized to the number of positions.
+     */
+    virtual void evaluateBatch(const positionBatch& batch,std::vector<double>& values) const;
+};
+
+/*! \brief Weights of the terms of the heuristic evaluator.
+ *
+ */
+struct heuristicWeights
+{
+    double empty; /*!< Weight of every empty cell. */
+    double merges; /*!< Weight of every pair of equal neighbours. */
+    double monotonicity; /*!< Penalty per exponent step against the dominant direction of a line. */
+    double corner; /*!< Weight of the larger exponent at the two ends of a line. */
+
+    heuristicWeights(); /*!< Make the default weights. */
+};
+
+/*! \brief Hand-tuned evaluation as a sum of per-row and per-column terms.
+ *
+ *  Every row and every column scores its empty cells, its merge potential, its
+ *  monotonicity and how large the tiles at its ends are.
+ */
+class heuristicEvaluator : public evaluator
+{
+private:
+    heuristicWeights weights; /*!< The weights of the terms. */
+public:
+    /*! \brief Make a new heuristic evaluator.
+     * 
+     *  \param weights The weights of the terms.
+     */
+    heuristicEvaluator(const heuristicWeights& weights = heuristicWeights());
+
+    /*! \brief Score a single row or column.
+     * 
+     *  \param line The first cell exponent of the line.
+     *  \param stride The distance between two cells of the line.
+     *  \param length The number of cells in the line.
+     *  \return The score of the line.
+     */
+    double evaluateLine(const unsigned char* line,const unsigned stride,const unsigned length) const;
+
+    double evaluate(const unsigned char* cells,const unsigned size) const;
+};
+
+/*! \brief Heuristic evaluator that looks up the scores of 4x4 lines.
+ *
+ *  The weighted sum of all heuristic terms of every possible line of four cells
+ *  is computed once into a 65536-entry table, so a 4x4 position is scored with
+ *  eight lookups. Other sizes and tiles above 32768 fall back to the
+ *  heuristicEvaluator.
+ */
+class tableEvaluator : public heuristicEvaluator
+{
+private:
+    std::vector<double> lineScores; /*!< The score of every line, indexed like the line tables. */
+public:
+    /*! \brief Make a new table evaluator.
+     * 
+     *  \param weights The weights of the terms.
+     */
+    tableEvaluator(const heuristicWeights& weights = heuristicWeights());
+
+    /*! \brief Evaluate a packed 4x4 position.
+     * 
+     *  \param packed The packed position.
+     *  \return The value of the position.
+     */
+    double evaluatePacked(const packedBoard packed) const;
+
+    double evaluate(const unsigned char* cells,const unsigned size) const;
+};
+
+/*! \brief N-tuple network: a sum of learned weights indexed by groups of cells.
+ *
+ *  Every tuple is a list of cell indices. Its weight table has 16^length entries,
+ *  indexed by the exponents of its cells (clipped to 15) as base-16 digits.
+ *  Batches are evaluated tuple by tuple, so that each weight table is streamed
+ *  through the cache once per batch instead of once per position.
+ */
+class ntupleEvaluator : public evaluator
+{
+private:
+    std::vector< std::vector<unsigned> > tuples; /*!< The cell indices of every tuple. */
+    std::vector< std::vector<float> > weights; /*!< The weight table of every tuple. */
+
+    /*! \brief Compute the weight table index of a tuple.
+     * 
+     *  \param tuple The index of the tuple.
+     *  \param cells The cell exponents of the position.
+     *  \return The index into the weight table of the tuple.
+     */
+    unsigned tupleIndex(const unsigned tuple,const unsigned char* cells) const;
+
+public:
+    /*! \brief Make a new n-tuple network with all weights set to 0.
+     * 
+     *  \param tuples The cell indices of every tuple (at most 6 cells each).
+     */
+    ntupleEvaluator(const std::vector< std::vector<unsigned> >& tuples);
+
+    /*! \brief Make the tuples of all rows and columns of a board.
+     * 
+     *  \param size The number of rows and columns (at most 6).
+     *  \return The cell indices of all rows and columns.
+     */
+    static std::vector< std::vector<unsigned> > lineTuples(const unsigned size);
+
+    /*! \brief Get the weight table of a tuple, e.g. to load trained weights.
+     * 
+     *  \param tuple The index of the tuple.
+     *  \return The weight table.
+     */
+    std::vector<float>& getWeights(const unsigned tuple);
+
+    double evaluate(const unsigned char* cells,const unsigned size) const;
+
+    void evaluateBatch(const positionBatch& batch,std::vector<double>& values) const;
+};
+
+#endif // EVALUATOR_H
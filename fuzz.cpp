@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file fuzz.cpp
+ * \brief File contains the implementation of the differential fuzzing harness.
+ * 
+ */
+
+#include "fuzz.h"
+#include "packed.h"
+#include "position.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+// Game state of a move, derived like board::move() from the cells around it.
+// This deliberately copies the rules of the reference rather than a spec: a
+// full board always loses, and a win tile on the board wins even after an
+// invalid move. A change of these rules in board::move() has to be made here
+// too, it is not a mismatch of the engines.
+static gameState_t expectedState(const std::vector<unsigned char>& before,const unsigned char* after,const bool changed,const unsigned winExponent)
+{
+    bool spaceLeft = false;
+    for(const unsigned char exponent : before) if(exponent == 0) spaceLeft = true;
+    if(!spaceLeft) return LOOSE;
+    for(unsigned i = 0; i < before.size(); ++i) if(after[i] >= winExponent) return WIN;
+    return changed ? UNFINISHED : INVALID;
+}
+
+// Describe a mismatch between an engine and the reference.
+static std::string describeMismatch(const char* engine,const char* what,const std::vector<unsigned char>& before,const unsigned size,const char direction)
+{
+    std::ostringstream description;
+    description << engine << " differs in " << what << " moving " << direction << " on the " << size << "x" << size << " exponents";
+    for(const unsigned char exponent : before) description << " " << unsigned(exponent);
+    return description.str();
+}
+
+differentialChecker::differentialChecker()
+{
+    // Integer weights keep the sums exact, whatever order the batch adds them in.
+    std::mt19937 mt(1);
+    for(unsigned size = minFuzzSize; size <= 4; ++size) {
+        this->ntuples.push_back(ntupleEvaluator(ntupleEvaluator::lineTuples(size)));
+        for(unsigned t = 0; t < 2*size; ++t) {
+            for(float& weight : this->ntuples.back().getWeights(t)) weight = float(mt() % 1000);
+        }
+    }
+    for(unsigned size = minFuzzSize; size <= maxFuzzSize; ++size) this->batches.push_back(positionBatch(size));
+}
+
+bool differentialChecker::checkMove(board& reference,const unsigned winExponent,const char direction,gameState_t& state,std::string& failure)
+{
+    const unsigned size = reference.getSize();
+    this->before = reference.getExponents();
+    unsigned referenceScore = 0;
+    state = reference.move(direction,referenceScore);
+    const std::vector<unsigned char>& after = reference.getExponents();
+
+    bool full = true;
+    for(const unsigned char exponent : this->before) if(exponent == 0) full = false;
+    if(full) {
+        if(state != LOOSE) failure = describeMismatch("board::move","the state of a full board",this->before,size,direction);
+        return state == LOOSE;
+    }
+
+    this->result.assign(size*size,0);
+    unsigned score = 0;
+    bool changed = movePosition(this->before.data(),this->result.data(),size,direction,score);
+    if(this->result != after) failure = describeMismatch("movePosition","the cells",this->before,size,direction);
+    else if(score != referenceScore) failure = describeMismatch("movePosition","the score",this->before,size,direction);
+    else if(expectedState(this->before,this->result.data(),changed,winExponent) != state) failure = describeMismatch("movePosition","the state",this->before,size,direction);
+    if(!failure.empty()) return false;
+
+    // The packed engine may refuse positions with tiles above 32768, but only those.
+    unsigned char maxExponent = 0;
+    for(const unsigned char exponent : after) if(exponent > maxExponent) maxExponent = exponent;
+    if(size == 4) {
+        packedBoard packed,moved;
+        if(packBoard(this->before.data(),packed)) {
+            score = 0;
+            if(!movePacked(packed,direction,moved,score)) {
+                if(maxExponent <= 15) failure = describeMismatch("movePacked","refusing the move",this->before,size,direction);
+            }
+            else {
+                unpackBoard(moved,this->result.data());
+                if(this->result != after) failure = describeMismatch("movePacked","the cells",this->before,size,direction);
+                else if(score != referenceScore) failure = describeMismatch("movePacked","the score",this->before,size,direction);
+                else if(expectedState(this->before,this->result.data(),moved != packed,winExponent) != state) failure = describeMismatch("movePacked","the state",this->before,size,direction);
+            }
+        }
+    }
+    return failure.empty();
+}
+
+bool differentialChecker::checkEvaluators(const positionBatch& batch,std::string& failure)
+{
+    // Every evaluation is compared with the heuristic value, which is computed once.
+    const unsigned size = batch.getSize();
+    this->references.resize(batch.getCount());
+    for(unsigned i = 0; i < batch.getCount(); ++i) {
+        this->references[i] = this->heuristic.evaluate(batch.getPosition(i),size);
+        if(this->table.evaluate(batch.getPosition(i),size) != this->references[i]) {
+            std::ostringstream description;
+            description << "tableEvaluator differs from heuristicEvaluator on the " << size << "x" << size << " exponents";
+            for(unsigned k = 0; k < size*size; ++k) description << " " << unsigned(batch.getPosition(i)[k]);
+            failure = description.str();
+            return false;
+        }
+    }
+
+    // The heuristic evaluator keeps the default batch loop over evaluate(), so
+    // only the n-tuple networks have a batch path of their own to compare.
+    if(size < minFuzzSize + this->ntuples.size()) {
+        const ntupleEvaluator& ntuple = this->ntuples.at(size - minFuzzSize);
+        ntuple.evaluateBatch(batch,this->values);
+        for(unsigned i = 0; i < batch.getCount(); ++i) {
+            if(this->values.at(i) != ntuple.evaluate(batch.getPosition(i),size)) {
+                failure = "ntupleEvaluator::evaluateBatch differs from single evaluations";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool differentialChecker::check(const uint8_t* data,const size_t length,std::string& failure)
+{
+    failure.clear();
+    if(length < 2) return true;
+
+    // Header: size and win tile, then the cells, mostly empty or small tiles.
+    const unsigned size = minFuzzSize + data[0] % (maxFuzzSize - minFuzzSize + 1);
+    const unsigned winExponent = 3 + data[1] % 15;
+    board reference(size,1u << winExponent);
+    size_t position = 2;
+    for(unsigned i = 0; i < size*size && position < length; ++i,++position) {
+        if(data[position] >= 96) reference(i / size,i % size) = data[position] % 18;
+    }
+
+    positionBatch& batch = this->batches.at(size - minFuzzSize);
+    batch.clear();
+    batch.add(reference.getExponents());
+    for(; position < length; ++position) {
+        const char direction = "wasd"[data[position] & 3];
+        gameState_t state;
+        if(!this->checkMove(reference,winExponent,direction,state,failure)) return false;
+        if(state == LOOSE) break;
+        batch.add(reference.getExponents());
+
+        // Spawn a 2 or a 4 into an empty cell chosen by the rest of the byte.
+        const std::vector<unsigned char>& cells = reference.getExponents();
+        unsigned nEmpty = 0;
+        for(const unsigned char exponent : cells) if(exponent == 0) ++nEmpty;
+        if(nEmpty == 0) continue;
+        unsigned spawn = (data[position] >> 3) % nEmpty;
+        unsigned i = 0;
+        while(cells[i] != 0 || spawn-- != 0) ++i;
+        reference(i / size,i % size) = 1 + ((data[position] >> 2) & 1);
+    }
+    return this->checkEvaluators(batch,failure);
+}
+
+fuzzConfig::fuzzConfig() : nCases(1000000), nThreads(1), seed(0), maxInputLength(96)
+{
+}
+
+bool runDifferentialFuzz(const fuzzConfig& config,std::ostream& out)
+{
+    std::atomic<bool> failed(false);
+    std::atomic<uint64_t> nChecked(0);
+    std::mutex failureMutex;
+    std::string failure;
+    std::vector<uint8_t> failingInput;
+
+    // Static assignment of cases to threads keeps a run repeatable.
+    auto fuzzWorker = [&](const unsigned id) {
+        std::seed_seq seeds {config.seed,id};
+        std::mt19937 mt(seeds);
+        differentialChecker checker;
+        std::vector<uint8_t> input;
+        std::string threadFailure;
+        const uint64_t nCases = config.nCases/config.nThreads + (id < config.nCases % config.nThreads ? 1 : 0);
+        uint64_t i = 0;
+        for(; i < nCases && !failed.load(std::memory_order_relaxed); ++i) {
+            input.resize(2 + mt() % (config.maxInputLength - 1));
+            for(uint8_t& byte : input) byte = uint8_t(mt());
+            if(!checker.check(input.data(),input.size(),threadFailure)) {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if(!failed.exchange(true)) {
+                    failure = threadFailure;
+                    failingInput = input;
+                }
+                break;
+            }
+        }
+        nChecked += i;
+    };
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < config.nThreads; ++i) threads.push_back(std::thread(fuzzWorker,i));
+    for(std::thread& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    out << "Checked " << nChecked << " inputs in " << seconds << " s (" << (seconds > 0 ? nChecked/seconds : 0) << " inputs/s)" << std::endl;
+    if(failed) {
+        out << "Mismatch: " << failure << std::endl << "Input:";
+        for(const uint8_t byte : failingInput) out << " " << std::hex << std::setw(2) << std::setfill('0') << unsigned(byte);
+        out << std::dec << std::endl;
+    }
+    return !failed;
+}
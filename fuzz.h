@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file fuzz.h
+ * \brief File contains the definition of the differential fuzzing harness that
+ * checks the fast move and evaluation engines against the reference board.
+ * 
+ */
+
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "evaluator.h"
+
+/*! \brief Smallest board size generated by the fuzzer.
+ *
+ */
+const unsigned minFuzzSize = 2;
+
+/*! \brief Largest board size generated by the fuzzer.
+ *
+ */
+const unsigned maxFuzzSize = 8;
+
+/*! \brief Checks the fast engines against board::move() on inputs given as bytes.
+ *
+ *  An input is decoded into a board and a sequence of moves: byte 0 selects the
+ *  board size, byte 1 the win tile, the next size*size bytes the cell exponents
+ *  (including exponents above 15) and every remaining byte a move and the tile
+ *  spawned after it. Every move of the reference board is repeated with
+ *  movePosition() and movePacked(), which have to agree on the cells, the score
+ *  and the game state. All positions met are then evaluated by the table
+ *  evaluator against the heuristic one, and the batches of the n-tuple networks
+ *  against single evaluations. Any byte string is a valid input, so the checker can be driven
+ *  by libFuzzer as well as by random inputs.
+ */
+class differentialChecker
+{
+private:
+    heuristicEvaluator heuristic; /*!< The reference evaluator. */
+    tableEvaluator table; /*!< The table-driven evaluator. */
+    std::vector<ntupleEvaluator> ntuples; /*!< Line n-tuple networks with fixed weights for sizes 2 to 4. */
+    std::vector<positionBatch> batches; /*!< The positions of the current input, one batch per size. */
+    std::vector<unsigned char> before; /*!< The cells before the current move. */
+    std::vector<unsigned char> result; /*!< The cells moved by an engine. */
+    std::vector<double> values; /*!< The values of a batch. */
+    std::vector<double> references; /*!< The heuristic values of a batch, evaluated one by one. */
+
+    /*! \brief Check the move engines on one move of the reference board.
+     * 
+     *  \param reference The reference board, which is moved.
+     *  \param winExponent The exponent of the win tile of the reference board.
+     *  \param direction The direction of the move.
+     *  \param state The game state returned by the reference board.
+     *  \param failure The description of the first mismatch.
+     *  \return Whether all engines agree with the reference.
+     */
+    bool checkMove(board& reference,const unsigned winExponent,const char direction,gameState_t& state,std::string& failure);
+
+    /*! \brief Check the evaluators on a batch of positions.
+     * 
+     *  \param batch The positions.
+     *  \param failure The description of the first mismatch.
+     *  \return Whether all evaluators agree.
+     */
+    bool checkEvaluators(const positionBatch& batch,std::string& failure);
+public:
+    differentialChecker(); /*!< Make a new checker. */
+
+    /*! \brief Check all engines on one input.
+     * 
+     *  \param data The input bytes.
+     *  \param length The number of input bytes.
+     *  \param failure The description of the first mismatch.
+     *  \return Whether all engines agree with the reference.
+     */
+    bool check(const uint8_t* data,const size_t length,std::string& failure);
+};
+
+/*! \brief Parameters of a standalone fuzzing run.
+ *
+ */
+struct fuzzConfig
+{
+    uint64_t nCases; /*!< The number of random inputs to check. */
+    unsigned nThreads; /*!< The number of threads checking inputs. */
+    unsigned seed; /*!< The seed of the random inputs. */
+    size_t maxInputLength; /*!< The largest input length in bytes. */
+
+    fuzzConfig(); /*!< Default parameters. */
+};
+
+/*! \brief Check the engines on random inputs until a mismatch is found.
+ * 
+ *  Thread i checks the inputs of its own generator, seeded with the config seed
+ *  and i, so a run is repeatable for a fixed number of threads. The number of
+ *  checked inputs per second is written to out, and so are the description and
+ *  the bytes (in hex) of a failing input.
+ * 
+ *  A run checks a few 10^4 inputs per second and core, not millions: every
+ *  input replays about ten moves on board::move(), which is the reference and
+ *  the bottleneck. The engines work on one line at a time, so a default run of
+ *  10^6 inputs, with some 10^7 line moves, covers the lines of every size
+ *  many times over within a minute per core.
+ * 
+ *  \param config The parameters of the run.
+ *  \param out The stream for the report.
+ *  \return Whether all inputs passed.
+ */
+bool runDifferentialFuzz(const fuzzConfig& config,std::ostream& out);
+
+#endif // FUZZ_H
@@ -32,12 +32,12 @@
 
 #include "helper.h"
 
-void printGameoverMessage(const gameState_t moveState,const unsigned score) {
+void printGameoverMessage(const gameState_t moveState,const unsigned score,const unsigned winTile) {
     std::cout << "!!!   Game over  !!!" << std::endl;
     switch(moveState) {
         case WIN:
-            // Gameover condition 1: 2048 appears on the screen.
-            std::cout << "!!! 2048 REACHED !!!" << std::endl;
+            // Gameover condition 1: the win tile appears on the screen.
+            std::cout << "!!! " << winTile << " REACHED !!!" << std::endl;
             break;
         case LOOSE:
             // Gameover condition 2: All cells occupied.
@@ -49,7 +49,24 @@ void printGameoverMessage(const gameState_t moveState,const unsigned score) {
     std::cout << "Score: " << score << std::endl;
 }
 
-bool combineCells(const char direction,std::vector<unsigned>& nonZeroElements,unsigned& score) {
+unsigned tileValue(const unsigned exponent)
+{
+    assert(exponent < 32);
+    if(exponent == 0) return 0;
+    return 1u << exponent;
+}
+
+unsigned char tileExponent(const unsigned value)
+{
+    // Assert that the value is either empty or a power of two.
+    assert((value & (value - 1)) == 0);
+
+    unsigned char exponent = 0;
+    while((value >> exponent) > 1) ++exponent;
+    return exponent;
+}
+
+bool combineCells(const char direction,std::vector<unsigned char>& nonZeroElements,unsigned& score) {
 
     bool cellsMerged = false;
 
@@ -60,11 +77,11 @@ bool combineCells(const char direction,std::vector<unsigned>& nonZeroElements,un
     for(unsigned j = 0; j < nonZeroElements.size()-1; ++j) {
         if(nonZeroElements.at(j) == nonZeroElements.at(j+1)) {
             nonZeroElements.at(j) = 0;
-            nonZeroElements.at(j+1) *= 2;
+            nonZeroElements.at(j+1) += 1;
             cellsMerged = true;
             
-            // Update score.
-            score += nonZeroElements.at(j+1);
+            // Update score with the value of the merged tile.
+            score += tileValue(nonZeroElements.at(j+1));
             
             // If element j and j+1 are swapped skip element j+1.
             j++;
@@ -76,7 +93,7 @@ bool combineCells(const char direction,std::vector<unsigned>& nonZeroElements,un
     if(direction == DOWN || direction == RIGHT) std::reverse(nonZeroElements.begin(), nonZeroElements.end());
     
     // Remove zeros.
-    auto endIter = std::remove_if(nonZeroElements.begin(), nonZeroElements.end(), [](unsigned & elem) { if(elem == 0) return true; else return false;});
+    auto endIter = std::remove_if(nonZeroElements.begin(), nonZeroElements.end(), [](unsigned char & elem) { if(elem == 0) return true; else return false;});
     nonZeroElements.erase(endIter, nonZeroElements.end());
     
     return cellsMerged;
@@ -118,6 +135,24 @@ std::string centerNumberstring(const unsigned width, const unsigned inputNumber)
     return result;
 }
 
+/*! \brief Read a line from STDIN without buffering.
+ * 
+ *  The rest of the input stays unread for the keyboard reader, which reads the
+ *  file descriptor directly and would miss keys buffered by std::cin.
+ * 
+ *  \param line Receives the line without the line break.
+ *  \return Whether the input has not ended before the line break.
+ */
+static bool readLine(std::string& line) {
+    char c;
+    line.clear();
+    while(read(STDIN_FILENO,&c,1) == 1) {
+        if(c == '\n') return true;
+        line.push_back(c);
+    }
+    return false;
+}
+
 unsigned getBoardSize() {
     
     int boardSize;
@@ -126,7 +161,7 @@ unsigned getBoardSize() {
     
     std::cout << "How large should the board be ( > 4, default = 4)?";    
     while(!isValid) {
-        std::getline(std::cin,input);
+        readLine(input);
         if(input.empty()) {
             boardSize = 4;
             isValid = true;
@@ -147,7 +182,7 @@ unsigned getBoardSize() {
     return unsigned(boardSize);
 }
 
-char getActionCommandKey() {
+char getActionCommandKey(const bool withAssistKeys) {
 
     struct termios oldTerminal,newTerminal;
     int key;
@@ -160,8 +195,9 @@ char getActionCommandKey() {
     newTerminal.c_lflag &= ~( ICANON | ECHO );
     tcsetattr(STDIN_FILENO,TCSANOW,&newTerminal);
     
-    // Get character (w, s, a, d or q).
-    do { key = getchar(); } while(key != 97 && key != 100 && key != 119 && key != 115 && key != 113);
+    // Get character (w, s, a, d or q, and h or m with the assist keys).
+    do { key = getchar(); } while(key != 97 && key != 100 && key != 119 && key != 115 && key != 113
+                                  && !(withAssistKeys && (key == 104 || key == 109)));
     
     // Restore prior terminal mode.
     tcsetattr(STDIN_FILENO,TCSANOW,&oldTerminal);
@@ -176,7 +212,37 @@ char getActionCommandKey() {
             return UP;
         case 115:
             return DOWN;
+        case 104:
+            return HINT;
+        case 109:
+            return AUTOMOVE;
     }
 
     return QUIT;
 }
+
+void writeGenerator(std::ostream& stream,const std::mt19937& mt)
+{
+    // The textual representation is the only portable access to the state words,
+    // some libraries append the position in the state to them.
+    std::stringstream text;
+    text << mt;
+    std::vector<uint32_t> words;
+    uint32_t word;
+    while(text >> word) words.push_back(word);
+    writeBinary(stream,(uint32_t)words.size());
+    for(const uint32_t stateWord : words) writeBinary(stream,stateWord);
+}
+
+bool readGenerator(std::istream& stream,std::mt19937& mt)
+{
+    uint32_t nWords, word;
+    if(!readBinary(stream,nWords) || nWords > std::mt19937::state_size+1) return false;
+    std::stringstream text;
+    for(uint32_t i = 0; i < nWords; ++i) {
+        if(!readBinary(stream,word)) return false;
+        text << word << ' ';
+    }
+    text >> mt;
+    return !text.fail();
+}
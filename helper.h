@@ -34,7 +34,10 @@
 #ifndef HELPER_H
 #define HELPER_H
 
+#include <cstdint>
 #include <random>
+#include <vector>
+#include <string>
 #include <algorithm>
 #include <cassert>
 #include <iostream>
@@ -50,28 +53,50 @@ enum gameState_t { UNFINISHED, WIN, LOOSE, INVALID };
 /*! \brief Idiomatic directions/keys.
  * 
  */
-enum { UP = 'w', DOWN = 's', LEFT = 'a', RIGHT = 'd', QUIT = 'q' };
+enum { UP = 'w', DOWN = 's', LEFT = 'a', RIGHT = 'd', QUIT = 'q', HINT = 'h', AUTOMOVE = 'm', UNDO = 'u', REDO = 'r' };
 
 /*! \brief Print gameover message.
  * 
  * \param moveState The state of the game.
  * \param score The current score.
+ * \param winTile The tile value that wins the game.
  */
-void printGameoverMessage(const gameState_t moveState, const unsigned score);
+void printGameoverMessage(const gameState_t moveState, const unsigned score, const unsigned winTile = 2048);
+
+/*! \brief Convert a cell exponent into the tile value shown to the player.
+ * 
+ *  Cells store the base-2 logarithm of their tile, with 0 meaning an empty cell.
+ *
+ * \param exponent The exponent of the cell (0 = empty).
+ * \return The tile value 2^exponent, or 0 for an empty cell.
+ * 
+ */
+unsigned tileValue(const unsigned exponent);
+
+/*! \brief Convert a tile value into the exponent stored on the board.
+ * 
+ *  Inverse of tileValue(). The tile value has to be 0 or a power of two.
+ *
+ * \param value The tile value (0 = empty).
+ * \return The base-2 exponent of the tile, or 0 for an empty cell.
+ * 
+ */
+unsigned char tileExponent(const unsigned value);
 
 /*! \brief Combine numbers according to game rules.
  * 
- *  This function takes a vector of numbers that represents a single line of the board.
- *  These number are then combined according to game rules, depending on the direction
- *  of the current move.
+ *  This function takes a vector of cell exponents that represents a single line of the board.
+ *  These exponents are then combined according to game rules, depending on the direction
+ *  of the current move. Two merged cells with exponent e become one cell with exponent e+1,
+ *  which adds 2^(e+1) to the score.
  *
  * \param direction The direction in which to move the cells.
- * \param nonZeroElements All non-zero numbers in the line the vector represents.
+ * \param nonZeroElements All non-zero exponents in the line the vector represents.
  * \param score The present score.
  * \return Whether at least one cell pair was merged.
  * 
  */
-bool combineCells(const char direction,std::vector<unsigned>& nonZeroElements,unsigned& score);
+bool combineCells(const char direction,std::vector<unsigned char>& nonZeroElements,unsigned& score);
 
 /*! \brief Generate a new cell value for 2048.
  * 
@@ -107,8 +132,47 @@ unsigned getBoardSize();
  *  Get a single character (a, s, d, w or q) from the keyboard. These are used to 
  *  play the game or exit (q).
  * 
+ *  \param withAssistKeys Whether to accept h (hint) and m (automatic move) as well.
  *  \return The character obtained from the keybord.
  */
-char getActionCommandKey();
+char getActionCommandKey(const bool withAssistKeys = false);
+
+/*! \brief Write a plain value in the native binary representation.
+ * 
+ *  \param stream The output stream.
+ *  \param value The value.
+ */
+template<typename T>
+void writeBinary(std::ostream& stream,const T& value)
+{
+    stream.write(reinterpret_cast<const char*>(&value),sizeof(T));
+}
+
+/*! \brief Read a plain value written by writeBinary().
+ * 
+ *  \param stream The input stream.
+ *  \param value Receives the value.
+ *  \return Whether the value was read.
+ */
+template<typename T>
+bool readBinary(std::istream& stream,T& value)
+{
+    return bool(stream.read(reinterpret_cast<char*>(&value),sizeof(T)));
+}
+
+/*! \brief Write the complete state of a random number generator.
+ * 
+ *  \param stream The output stream.
+ *  \param mt The random number generator.
+ */
+void writeGenerator(std::ostream& stream,const std::mt19937& mt);
+
+/*! \brief Read the state of a random number generator written by writeGenerator().
+ * 
+ *  \param stream The input stream.
+ *  \param mt Receives the state.
+ *  \return Whether the state was read.
+ */
+bool readGenerator(std::istream& stream,std::mt19937& mt);
 
 #endif // HELPER_H
\ No newline at end of file
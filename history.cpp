@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file history.cpp
+ * \brief File contains the implementation of the compact undo/redo history of
+ * a game.
+ * 
+ */
+
+#include "history.h"
+#include <cassert>
+
+boardHistory::boardHistory(const std::size_t maxTurns,const std::size_t maxChanges)
+    : turns(maxTurns), changes(maxChanges), turnBegin(0), turnCursor(0), turnEnd(0), changeBegin(0), changeCursor(0), changeEnd(0)
+{
+    assert(maxTurns > 0 && maxChanges > 0);
+}
+
+void boardHistory::record(const std::vector<unsigned char>& before,const board& after,const unsigned scoreDelta,
+                          const gameState_t stateBefore,const gameState_t stateAfter,const bool wonBefore)
+{
+    const std::vector<unsigned char>& cells = after.getExponents();
+    assert(before.size() == cells.size());
+    // Cell indices and change counts are 16 bit.
+    assert(cells.size() <= 0xffff);
+
+    // A new turn replaces everything that could be redone.
+    this->turnEnd = this->turnCursor;
+    this->changeEnd = this->changeCursor;
+
+    uint16_t nChanges = 0;
+    for(std::size_t i = 0; i < cells.size(); ++i) nChanges += before[i] != cells[i];
+    if(nChanges > this->changes.size()) {
+        // The turn can never fit, forget everything instead of keeping a gap.
+        this->turnBegin = this->turnCursor = this->turnEnd;
+        this->changeBegin = this->changeCursor = this->changeEnd;
+        return;
+    }
+
+    // Forget the oldest turns until the new one fits into both rings.
+    while(this->turnEnd - this->turnBegin == this->turns.size()
+          || this->changeEnd + nChanges - this->changeBegin > this->changes.size()) {
+        this->changeBegin += this->turns[this->turnBegin % this->turns.size()].nChanges;
+        ++this->turnBegin;
+    }
+
+    for(std::size_t i = 0; i < cells.size(); ++i) {
+        if(before[i] == cells[i]) continue;
+        cellChange& change = this->changes[this->changeEnd++ % this->changes.size()];
+        change.cell = uint16_t(i);
+        change.before = before[i];
+        change.after = cells[i];
+    }
+    turnDelta& turn = this->turns[this->turnEnd++ % this->turns.size()];
+    turn.nChanges = nChanges;
+    turn.states = (unsigned char)(stateBefore | (stateAfter << 4));
+    turn.wins = (unsigned char)((wonBefore ? 1 : 0) | (after.hasWon() ? 2 : 0));
+    turn.scoreDelta = scoreDelta;
+    this->turnCursor = this->turnEnd;
+    this->changeCursor = this->changeEnd;
+}
+
+bool boardHistory::undo(board& gameBoard,unsigned& score,gameState_t& moveState)
+{
+    if(this->turnCursor == this->turnBegin) return false;
+
+    const turnDelta& turn = this->turns[--this->turnCursor % this->turns.size()];
+    const unsigned size = gameBoard.getSize();
+    for(unsigned i = 0; i < turn.nChanges; ++i) {
+        const cellChange& change = this->changes[--this->changeCursor % this->changes.size()];
+        gameBoard(change.cell/size,change.cell%size) = change.before;
+    }
+    gameBoard.setWon((turn.wins & 1) != 0);
+    score -= turn.scoreDelta;
+    moveState = gameState_t(turn.states & 0xf);
+    return true;
+}
+
+bool boardHistory::redo(board& gameBoard,unsigned& score,gameState_t& moveState)
+{
+    if(this->turnCursor == this->turnEnd) return false;
+
+    const turnDelta& turn = this->turns[this->turnCursor++ % this->turns.size()];
+    const unsigned size = gameBoard.getSize();
+    for(unsigned i = 0; i < turn.nChanges; ++i) {
+        const cellChange& change = this->changes[this->changeCursor++ % this->changes.size()];
+        gameBoard(change.cell/size,change.cell%size) = change.after;
+    }
+    gameBoard.setWon((turn.wins & 2) != 0);
+    score += turn.scoreDelta;
+    moveState = gameState_t(turn.states >> 4);
+    return true;
+}
+
+std::size_t boardHistory::getUndoCount() const
+{
+    return this->turnCursor - this->turnBegin;
+}
+
+std::size_t boardHistory::getRedoCount() const
+{
+    return this->turnEnd - this->turnCursor;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file history.h
+ * \brief File contains the definition of the compact undo/redo history of a game.
+ * 
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "board.h"
+#include "helper.h"
+
+/*! \brief Bounded undo/redo history that stores every turn as a delta.
+ *
+ *  A turn is the move and the spawn after it. It is stored as the list of
+ *  changed cells (index, exponent before, exponent after), the score gained and
+ *  the game state before and after, so a turn costs 8 bytes plus 4 bytes per
+ *  changed cell instead of a copy of the board. Boards of up to 255x255 cells
+ *  can be recorded. Undo and redo only touch the
+ *  changed cells. Turns and cell changes are kept in two rings of fixed size,
+ *  the oldest turns are forgotten when either is full.
+ */
+class boardHistory
+{
+private:
+    /*! \brief One changed cell. */
+    struct cellChange
+    {
+        uint16_t cell; /*!< The cell index row*size+col. */
+        unsigned char before; /*!< The exponent before the turn. */
+        unsigned char after; /*!< The exponent after the turn. */
+    };
+
+    /*! \brief One turn, its cell changes follow those of the previous turn. */
+    struct turnDelta
+    {
+        uint16_t nChanges; /*!< The number of changed cells. */
+        unsigned char states; /*!< The game states before (low nibble) and after (high nibble). */
+        unsigned char wins; /*!< Whether the win tile was reached before (bit 0) and after (bit 1). */
+        uint32_t scoreDelta; /*!< The score gained by the move. */
+    };
+
+    std::vector<turnDelta> turns; /*!< The ring of turns. */
+    std::vector<cellChange> changes; /*!< The ring of cell changes. */
+    uint64_t turnBegin; /*!< The oldest turn that can be undone. */
+    uint64_t turnCursor; /*!< The turn that redo() applies, all before it can be undone. */
+    uint64_t turnEnd; /*!< One past the newest recorded turn. */
+    uint64_t changeBegin; /*!< The first change of turnBegin. */
+    uint64_t changeCursor; /*!< The first change of turnCursor. */
+    uint64_t changeEnd; /*!< One past the last change of the newest turn. */
+
+public:
+    /*! \brief Make an empty history.
+     * 
+     *  \param maxTurns The largest number of turns that are kept.
+     *  \param maxChanges The largest number of cell changes that are kept.
+     */
+    boardHistory(const std::size_t maxTurns = 1 << 16,const std::size_t maxChanges = 1 << 19);
+
+    /*! \brief Record a turn, all turns that could be redone are dropped.
+     * 
+     *  \param before The cell exponents before the move.
+     *  \param after The board after the move and the spawn.
+     *  \param scoreDelta The score gained by the move.
+     *  \param stateBefore The game state before the move.
+     *  \param stateAfter The game state returned by the move.
+     *  \param wonBefore Whether the win tile was reached before the move.
+     */
+    void record(const std::vector<unsigned char>& before,const board& after,const unsigned scoreDelta,
+                const gameState_t stateBefore,const gameState_t stateAfter,const bool wonBefore);
+
+    /*! \brief Take back the last turn.
+     * 
+     *  \param gameBoard The board after the turn.
+     *  \param score The score after the turn.
+     *  \param moveState The game state after the turn.
+     *  \return Whether there was a turn to undo.
+     */
+    bool undo(board& gameBoard,unsigned& score,gameState_t& moveState);
+
+    /*! \brief Repeat the last turn that was taken back.
+     * 
+     *  \param gameBoard The board before the turn.
+     *  \param score The score before the turn.
+     *  \param moveState The game state before the turn.
+     *  \return Whether there was a turn to redo.
+     */
+    bool redo(board& gameBoard,unsigned& score,gameState_t& moveState);
+
+    /*! \brief Get the number of turns that can be undone.
+     * 
+     *  \return The number of turns.
+     */
+    std::size_t getUndoCount() const;
+
+    /*! \brief Get the number of turns that can be redone.
+     * 
+     *  \return The number of turns.
+     */
+    std::size_t getRedoCount() const;
+};
+
+#endif // HISTORY_H
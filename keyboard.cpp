@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file keyboard.cpp
+ * \brief File contains the implementation of the asynchronous keyboard reader.
+ * 
+ */
+
+#include "keyboard.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// The terminal that a fatal signal has to restore, while one is in raw mode.
+static const int terminalSignals[4] = {SIGINT,SIGTERM,SIGHUP,SIGQUIT};
+static int rawTerminalFd = -1;
+static struct termios rawTerminalSaved;
+static struct sigaction previousActions[4];
+
+// Restore the terminal, then die of the signal as without the handler.
+static void restoreTerminal(const int signal)
+{
+    if(rawTerminalFd >= 0) tcsetattr(rawTerminalFd,TCSANOW,&rawTerminalSaved);
+    struct sigaction action;
+    std::memset(&action,0,sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigaction(signal,&action,NULL);
+    raise(signal);
+}
+
+keyboardInput::keyboardInput(const int fd,const bool withAssistKeys)
+    : fd(fd), withAssistKeys(withAssistKeys), rawMode(false), wakeFd(-1), wakeWriteFd(-1), escapeState(0), ended(false)
+{
+    // Switch the terminal once for the whole game, pipes and files are read as
+    // they are. Only one input at a time owns the terminal mode.
+    if(isatty(fd) && rawTerminalFd < 0 && tcgetattr(fd,&this->savedTerminal) == 0) {
+        struct termios newTerminal = this->savedTerminal;
+        newTerminal.c_lflag &= ~(ICANON | ECHO | ISIG);
+        newTerminal.c_cc[VMIN] = 1;
+        newTerminal.c_cc[VTIME] = 0;
+        this->rawMode = tcsetattr(fd,TCSANOW,&newTerminal) == 0;
+    }
+    if(this->rawMode) {
+        rawTerminalFd = fd;
+        rawTerminalSaved = this->savedTerminal;
+        struct sigaction action;
+        std::memset(&action,0,sizeof(action));
+        action.sa_handler = restoreTerminal;
+        sigemptyset(&action.sa_mask);
+        for(unsigned i = 0; i < 4; ++i) sigaction(terminalSignals[i],&action,&previousActions[i]);
+    }
+
+    // Stop notifications go through an eventfd, or a pipe if there is none.
+    int pipeFds[2];
+    this->wakeFd = eventfd(0,EFD_CLOEXEC);
+    if(this->wakeFd >= 0) {
+        this->wakeWriteFd = this->wakeFd;
+    }
+    else if(pipe2(pipeFds,O_CLOEXEC) == 0) {
+        this->wakeFd = pipeFds[0];
+        this->wakeWriteFd = pipeFds[1];
+    }
+    else {
+        // Without a way to stop a reader thread, the input ends right away.
+        std::cerr << "Cannot read the keyboard: " << std::strerror(errno) << std::endl;
+        this->ended = true;
+        return;
+    }
+    this->reader = std::thread(&keyboardInput::work,this);
+}
+
+keyboardInput::~keyboardInput()
+{
+    if(this->reader.joinable()) {
+        uint64_t one = 1;
+        if(write(this->wakeWriteFd,&one,sizeof(one)) != sizeof(one)) std::cerr << "Cannot stop the keyboard reader." << std::endl;
+        this->reader.join();
+    }
+    if(this->wakeWriteFd >= 0 && this->wakeWriteFd != this->wakeFd) close(this->wakeWriteFd);
+    if(this->wakeFd >= 0) close(this->wakeFd);
+    if(this->rawMode) {
+        for(unsigned i = 0; i < 4; ++i) sigaction(terminalSignals[i],&previousActions[i],NULL);
+        rawTerminalFd = -1;
+        tcsetattr(this->fd,TCSANOW,&this->savedTerminal);
+    }
+}
+
+void keyboardInput::work()
+{
+    char buffer[4096];
+    std::deque<char> parsed;
+    struct pollfd fds[2] = {{this->fd,POLLIN,0},{this->wakeFd,POLLIN,0}};
+    while(1) {
+        if(poll(fds,2,-1) < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        if(fds[1].revents != 0) return;
+        if(fds[0].revents == 0) continue;
+
+        ssize_t length = read(this->fd,buffer,sizeof(buffer));
+        if(length < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if(length <= 0) break;
+
+        // Queue all keys of a read at once.
+        this->parse(buffer,length,parsed);
+        if(parsed.empty()) continue;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->keys.insert(this->keys.end(),parsed.begin(),parsed.end());
+        }
+        parsed.clear();
+        this->condition.notify_one();
+    }
+
+    // The input has ended or failed.
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->ended = true;
+    }
+    this->condition.notify_one();
+}
+
+void keyboardInput::parse(const char* data,const std::size_t length,std::deque<char>& parsed)
+{
+    for(std::size_t i = 0; i < length; ++i) {
+        char c = data[i];
+
+        // Arrow keys are ESC [ A..D (or ESC O A..D), possibly split over two reads.
+        if(this->escapeState == 1) {
+            this->escapeState = (c == '[' || c == 'O') ? 2 : 0;
+            if(this->escapeState == 2) continue;
+        }
+        else if(this->escapeState == 2) {
+            this->escapeState = 0;
+            if(c == 'A') parsed.push_back(UP);
+            else if(c == 'B') parsed.push_back(DOWN);
+            else if(c == 'C') parsed.push_back(RIGHT);
+            else if(c == 'D') parsed.push_back(LEFT);
+            continue;
+        }
+
+        if(c == '\033') this->escapeState = 1;
+        else if(c == '\003') parsed.push_back(QUIT); // Ctrl-C, signal keys are off in raw mode.
+        else if(c == UP || c == DOWN || c == LEFT || c == RIGHT || c == QUIT || c == UNDO || c == REDO) parsed.push_back(c);
+        else if(this->withAssistKeys && (c == HINT || c == AUTOMOVE)) parsed.push_back(c);
+    }
+}
+
+bool keyboardInput::nextKey(const board& gameBoard,char& key)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->condition.wait(lock,[this]() { return !this->keys.empty() || this->ended; });
+    if(this->keys.empty()) {
+        key = QUIT;
+        return true;
+    }
+    key = this->keys.front();
+    this->keys.pop_front();
+    return true;
+}
+
+bool keyboardInput::isRawMode() const
+{
+    return this->rawMode;
+}
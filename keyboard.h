@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file keyboard.h
+ * \brief File contains the definition of the asynchronous keyboard reader.
+ * 
+ */
+
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <termios.h>
+#include "session.h"
+
+/*! \brief Command keys read in the background from a terminal or a pipe.
+ *
+ *  A terminal is switched into non-canonical mode without echo and without
+ *  signal keys once, when the input is made, and restored by the destructor.
+ *  Ctrl-C is read as QUIT, and SIGINT, SIGTERM, SIGHUP and SIGQUIT restore the
+ *  terminal before they end the program. A reader thread waits with
+ *  poll(), reads everything that is available at once and queues the command
+ *  keys, so keys typed or piped while the board is drawn are never throttled.
+ *  Besides w, a, s, d, q, u (undo) and r (redo) the arrow keys are understood.
+ *  Other input is skipped. The end of the input quits. Never suspends.
+ */
+class keyboardInput : public inputSource
+{
+private:
+    int fd; /*!< The file descriptor the keys are read from. */
+    bool withAssistKeys; /*!< Whether HINT and AUTOMOVE are queued as well. */
+    bool rawMode; /*!< Whether the terminal mode was changed. */
+    struct termios savedTerminal; /*!< The terminal mode to restore. */
+    int wakeFd; /*!< An eventfd (or the read end of a pipe) that stops the reader thread. */
+    int wakeWriteFd; /*!< The descriptor written to stop the reader thread. */
+    unsigned escapeState; /*!< Progress through an arrow key escape sequence (reader thread only). */
+    std::deque<char> keys; /*!< The queued command keys. */
+    bool ended; /*!< Whether the input has ended. */
+    std::mutex mutex; /*!< Protects the queue and the end flag. */
+    std::condition_variable condition; /*!< Signals new keys or the end of the input. */
+    std::thread reader; /*!< Reads the input. */
+
+    /*! \brief The loop of the reader thread. */
+    void work();
+
+    /*! \brief Translate input bytes into command keys.
+     * 
+     *  \param data The bytes.
+     *  \param length The number of bytes.
+     *  \param parsed Receives the command keys.
+     */
+    void parse(const char* data,const std::size_t length,std::deque<char>& parsed);
+
+public:
+    /*! \brief Start reading keys.
+     * 
+     *  \param fd The file descriptor to read from (a terminal, pipe or file).
+     *  \param withAssistKeys Whether to return HINT and AUTOMOVE as well (for an assistedInput).
+     */
+    keyboardInput(const int fd,const bool withAssistKeys = false);
+
+    ~keyboardInput(); /*!< Stop reading and restore the terminal mode. */
+
+    bool nextKey(const board& gameBoard,char& key);
+
+    /*! \brief Check whether a terminal was switched into non-canonical mode.
+     * 
+     *  \return Whether the terminal mode was changed.
+     */
+    bool isRawMode() const;
+};
+
+#endif // KEYBOARD_H
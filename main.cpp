@@ -35,12 +35,33 @@
  */
 
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "board.h"
 #include "helper.h"
+#include "server.h"
+#include "session.h"
+#include "simulation.h"
+#include "ponder.h"
+#include "keyboard.h"
+#include "fuzz.h"
 
 /*! \brief Main routine.
  * 
  *  Main routine containing the main function of the 2048 game including the event loop.
+ *  Commandline options:
+ *  - --win N: Win the game at tile N (a power of two, default = 2048).
+ *  - --continue: Keep playing after the win tile has been reached.
+ *  - --serve PATH: Host games for clients connecting to the Unix domain socket PATH.
+ *  - --assist: Ponder in the background, h shows a hint and m plays the suggested move.
+ *  - --simulate N: Play N games with the greedy heuristic policy and print statistics.
+ *  - --threads T: The number of threads of a simulation (default = 1).
+ *  - --processes K: Run a simulation in K worker processes instead of threads.
+ *  - --export PREFIX: Export the moves of a simulation as training data shards PREFIX-W-NNNNN.g2048ds.
+ *  - --seed S: The seed of a simulation (default = random, 0 with --checkpoint).
+ *  - --checkpoint PATH: Write a checkpoint of a simulation to PATH every minute and continue from it (not with --processes).
+ *  - --fuzz N: Check the fast move and evaluation engines against the reference board on N random inputs.
+ *    Uses --threads and --seed like a simulation.
  * 
  *  \param argc The number of commandline elements.
  *  \param argv The commandline elements.
@@ -49,47 +70,161 @@
  */
 int main(int argc, char **argv) {
 
+    // Parse commandline options.
+    unsigned winTile = 2048;
+    bool continueAfterWin = false;
+    bool assist = false;
+    std::string socketPath;
+    unsigned long nSimulatedGames = 0;
+    unsigned nThreads = 1;
+    bool useProcesses = false;
+    std::string seedOption;
+    std::string checkpointPath;
+    std::string exportPrefix;
+    unsigned long nFuzzCases = 0;
+    for(int i = 1; i < argc; ++i) {
+        if(std::strcmp(argv[i],"--win") == 0 && i+1 < argc) {
+            winTile = unsigned(std::strtoul(argv[++i],NULL,10));
+            if(winTile < 4 || (winTile & (winTile - 1)) != 0) {
+                std::cerr << "The win tile has to be a power of two >= 4." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if(std::strcmp(argv[i],"--continue") == 0) {
+            continueAfterWin = true;
+        }
+        else if(std::strcmp(argv[i],"--assist") == 0) {
+            assist = true;
+        }
+        else if(std::strcmp(argv[i],"--serve") == 0 && i+1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--simulate") == 0 && i+1 < argc) {
+            nSimulatedGames = std::strtoul(argv[++i],NULL,10);
+        }
+        else if(std::strcmp(argv[i],"--threads") == 0 && i+1 < argc) {
+            nThreads = unsigned(std::strtoul(argv[++i],NULL,10));
+            if(nThreads == 0) {
+                std::cerr << "The number of threads has to be at least 1." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if(std::strcmp(argv[i],"--processes") == 0 && i+1 < argc) {
+            nThreads = unsigned(std::strtoul(argv[++i],NULL,10));
+            useProcesses = true;
+            if(nThreads == 0) {
+                std::cerr << "The number of processes has to be at least 1." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if(std::strcmp(argv[i],"--seed") == 0 && i+1 < argc) {
+            seedOption = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--checkpoint") == 0 && i+1 < argc) {
+            checkpointPath = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--export") == 0 && i+1 < argc) {
+            exportPrefix = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--fuzz") == 0 && i+1 < argc) {
+            nFuzzCases = std::strtoul(argv[++i],NULL,10);
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--win N] [--continue] [--assist] [--serve PATH] [--simulate N [--threads T | --processes K] [--seed S] [--checkpoint PATH] [--export PREFIX]] [--fuzz N [--threads T] [--seed S]]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Worker processes write no checkpoints, so a checkpointed run has to use threads.
+    if(useProcesses && !checkpointPath.empty()) {
+        std::cerr << "A simulation in worker processes can't be checkpointed, use --threads with --checkpoint." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Server mode: host many games over a Unix domain socket instead of playing one.
+    if(!socketPath.empty()) {
+        server gameServer(socketPath);
+        if(!gameServer.start() || !gameServer.run()) return EXIT_FAILURE;
+        return EXIT_SUCCESS;
+    }
+
+    // Fuzzing mode: compare the fast engines with the reference board.
+    if(nFuzzCases > 0) {
+        fuzzConfig config;
+        config.nCases = nFuzzCases;
+        config.nThreads = nThreads;
+        config.seed = seedOption.empty() ? std::random_device()() : unsigned(std::strtoul(seedOption.c_str(),NULL,10));
+        return runDifferentialFuzz(config,std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Simulation mode: play many games without drawing them.
+    if(nSimulatedGames > 0) {
+        tableEvaluator eval;
+        simulationConfig config;
+        config.winTile = winTile;
+        config.continueAfterWin = continueAfterWin;
+        config.nGames = nSimulatedGames;
+        config.nThreads = nThreads;
+        // A resumed run needs the same seed, so checkpointed runs don't pick a random one.
+        if(!seedOption.empty()) config.seed = unsigned(std::strtoul(seedOption.c_str(),NULL,10));
+        else if(checkpointPath.empty()) config.seed = std::random_device()();
+        config.checkpointPath = checkpointPath;
+        config.exportPrefix = exportPrefix;
+        config.makePolicy = [&eval]() { return greedyPolicy(eval); };
+        simulationStatistics stats;
+        bool finished = useProcesses ? runSimulationProcesses(config,stats) : runSimulation(config,stats);
+        stats.print(std::cout);
+        return finished ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Get board size from STDIN.
     unsigned boardSize = getBoardSize();
 
     // Initialize random number generator.
     std::random_device rd;
-    std::mt19937 mt(rd());
 
-    // Make new board.
-    unsigned score = 0;
-    board myBoard(boardSize);
-    myBoard.addRandomValue(mt);
+    // Make new game session that reads its moves from the keyboard (or a pipe).
+    keyboardInput keyboard(STDIN_FILENO,assist);
+
+    // Assisted play: hints come from a cache that is warmed while the player thinks.
+    std::unique_ptr<tableEvaluator> eval;
+    std::unique_ptr<transpositionTable> cache;
+    std::unique_ptr<expectimaxSearch> hintSearch;
+    std::unique_ptr<ponderer> background;
+    std::unique_ptr<assistedInput> assistant;
+    if(assist) {
+        eval.reset(new tableEvaluator());
+        cache.reset(new transpositionTable());
+        hintSearch.reset(new expectimaxSearch(*eval));
+        hintSearch->setCache(cache.get());
+        background.reset(new ponderer(*eval,*cache));
+        assistant.reset(new assistedInput(keyboard,*background,*hintSearch,std::chrono::milliseconds(200),[](const searchResult& hint) {
+            const char* name = hint.move == UP ? "up (w)" : hint.move == DOWN ? "down (s)" : hint.move == LEFT ? "left (a)" : "right (d)";
+            if(hint.move == QUIT) std::cout << "Hint: no move left" << std::endl;
+            else std::cout << "Hint: " << name << ", searched " << hint.depth << " moves ahead" << std::endl;
+        }));
+    }
+    session game(boardSize,assist ? static_cast<inputSource*>(assistant.get()) : &keyboard,rd(),winTile,continueAfterWin);
+    game.enableHistory();
 
     // Refresh screen + draw board for the first time.
     std::cout << std::string(80,'\n');
-    std::cout << "Score: " << score << std::endl;
-    myBoard.draw();
-    
+    std::cout << "Score: " << game.getScore() << std::endl;
+    game.getBoard().draw();
+
+    // Draw the board after every valid move until the game is over.
+    game.setObserver([winTile](const session& currentGame,const gameState_t moveState) {
+        if(currentGame.isFinished()) return;
+        if(moveState == WIN) std::cout << "!!! " << winTile << " REACHED, keep going !!!" << std::endl;
+        currentGame.getBoard().draw();
+        std::cout << "Score: " << currentGame.getScore() << std::endl;
+    });
+
     // Event loop.
-    gameState_t moveState = UNFINISHED;
-    char actionCommandKey;
-    while(1) {
-        do {
-            actionCommandKey = getActionCommandKey();
-            if(actionCommandKey == QUIT) break;
-            moveState = myBoard.move(actionCommandKey,score);
-        } while(moveState == INVALID);
-        if(actionCommandKey == QUIT) break;
-
-        // Add a new value to the board.
-        myBoard.addRandomValue(mt);
-        
-        // If gameover, print message.
-        if(moveState == WIN || moveState == LOOSE) {
-            printGameoverMessage(moveState,score);
-            break;
-        }
+    game.resume();
 
-        // Not gameover, draw board.
-        myBoard.draw();
-        std::cout << "Score: " << score << std::endl;
-    }
+    // If gameover, print message.
+    if(!game.hasQuit()) printGameoverMessage(game.getMoveState(),game.getScore(),winTile);
     
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file packed.cpp
+ * \brief File contains the implementation of packed 4x4 boards and their line
+ * tables.
+ * 
+ */
+
+#include "packed.h"
+#include "helper.h"
+
+// Reverse the order of the four nibbles of a line.
+static uint16_t reverseLine(const uint16_t line)
+{
+    return uint16_t(((line & 0xf) << 12) | ((line & 0xf0) << 4) | ((line >> 4) & 0xf0) | (line >> 12));
+}
+
+lineTables::lineTables() : towardLow(65536), towardHigh(65536), scoreLow(65536), scoreHigh(65536)
+{
+    for(unsigned line = 0; line < 65536; ++line) {
+        // Merge pairs starting at the lowest nibble, like combineCells().
+        unsigned char out[4] = {0,0,0,0};
+        unsigned nOut = 0;
+        unsigned char pending = 0;
+        uint32_t score = 0;
+        for(unsigned k = 0; k < 4; ++k) {
+            unsigned char exponent = (line >> (4*k)) & 0xf;
+            if(exponent == 0) continue;
+            if(pending == 0) {
+                pending = exponent;
+            }
+            else if(pending == exponent) {
+                out[nOut++] = exponent + 1;
+                score += tileValue(exponent + 1);
+                pending = 0;
+            }
+            else {
+                out[nOut++] = pending;
+                pending = exponent;
+            }
+        }
+        if(pending != 0) out[nOut++] = pending;
+
+        uint16_t result = 0;
+        for(unsigned k = 0; k < 4; ++k) {
+            if(out[k] > 15) score = lineOverflow;
+            result |= uint16_t((out[k] & 0xf) << (4*k));
+        }
+        this->towardLow[line] = result;
+        this->scoreLow[line] = score;
+    }
+
+    // Moving towards the highest nibble is moving the reversed line towards the lowest.
+    for(unsigned line = 0; line < 65536; ++line) {
+        uint16_t reversed = reverseLine(line);
+        this->towardHigh[line] = reverseLine(this->towardLow[reversed]);
+        this->scoreHigh[line] = this->scoreLow[reversed];
+    }
+}
+
+const lineTables& getLineTables()
+{
+    static const lineTables tables;
+    return tables;
+}
+
+bool packBoard(const unsigned char* cells,packedBoard& packed)
+{
+    packed = 0;
+    for(unsigned i = 0; i < 16; ++i) {
+        if(cells[i] > 15) return false;
+        packed |= packedBoard(cells[i]) << (4*i);
+    }
+    return true;
+}
+
+void unpackBoard(const packedBoard packed,unsigned char* cells)
+{
+    for(unsigned i = 0; i < 16; ++i) cells[i] = (packed >> (4*i)) & 0xf;
+}
+
+packedBoard transposePacked(const packedBoard packed)
+{
+    // Swap the off-diagonal nibbles of every 2x2 block, then the off-diagonal 2x2 blocks.
+    packedBoard a1 = packed & 0xF0F00F0FF0F00F0FULL;
+    packedBoard a2 = packed & 0x0000F0F00000F0F0ULL;
+    packedBoard a3 = packed & 0x0F0F00000F0F0000ULL;
+    packedBoard a = a1 | (a2 << 12) | (a3 >> 12);
+    packedBoard b1 = a & 0xFF00FF0000FF00FFULL;
+    packedBoard b2 = a & 0x00FF00FF00000000ULL;
+    packedBoard b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+bool movePacked(const packedBoard packed,const char direction,packedBoard& result,unsigned& score)
+{
+    const lineTables& tables = getLineTables();
+
+    // UP/DOWN move along the 16 bit words, LEFT/RIGHT along the transposed words.
+    bool towardLow = direction == UP || direction == LEFT;
+    packedBoard lines = (direction == UP || direction == DOWN) ? packed : transposePacked(packed);
+    const std::vector<uint16_t>& moveTable = towardLow ? tables.towardLow : tables.towardHigh;
+    const std::vector<uint32_t>& scoreTable = towardLow ? tables.scoreLow : tables.scoreHigh;
+
+    packedBoard moved = 0;
+    unsigned moveScore = 0;
+    for(unsigned i = 0; i < 4; ++i) {
+        uint16_t line = (lines >> (16*i)) & 0xffff;
+        if(scoreTable[line] == lineOverflow) return false;
+        moved |= packedBoard(moveTable[line]) << (16*i);
+        moveScore += scoreTable[line];
+    }
+
+    result = (direction == UP || direction == DOWN) ? moved : transposePacked(moved);
+    score += moveScore;
+    return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file packed.h
+ * \brief File contains the definition of the packed 64 bit representation of
+ * 4x4 boards and of the line tables that move them with lookups.
+ * 
+ */
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <cstdint>
+#include <vector>
+
+/*! \brief A 4x4 position in 64 bits.
+ *
+ *  The exponent of cell (row,col) is the 4 bit nibble at bit 4*(4*row+col), so
+ *  every 16 bit word is one line of the row-major cell layout. Exponents above
+ *  15 (tiles above 32768) cannot be packed.
+ */
+typedef uint64_t packedBoard;
+
+/*! \brief Results of moving every possible line of four cells.
+ *
+ *  A line is indexed by its four exponents as base-16 digits, the cell that the
+ *  line moves to being the lowest digit. Lines whose move would create an
+ *  exponent above 15 are marked with the score lineOverflow.
+ */
+struct lineTables
+{
+    std::vector<uint16_t> towardLow; /*!< The line after moving towards its lowest nibble. */
+    std::vector<uint16_t> towardHigh; /*!< The line after moving towards its highest nibble. */
+    std::vector<uint32_t> scoreLow; /*!< The merge score of moving towards the lowest nibble. */
+    std::vector<uint32_t> scoreHigh; /*!< The merge score of moving towards the highest nibble. */
+
+    lineTables(); /*!< Compute all tables. */
+};
+
+/*! \brief Score marking lines that cannot be moved in the packed representation.
+ *
+ */
+const uint32_t lineOverflow = 0xffffffff;
+
+/*! \brief Get the line tables, computing them on first use.
+ * 
+ *  \return The line tables.
+ */
+const lineTables& getLineTables();
+
+/*! \brief Pack the cells of a 4x4 position.
+ * 
+ *  \param cells The 16 cell exponents, stored row by row.
+ *  \param packed The packed position.
+ *  \return Whether all exponents fit into 4 bits.
+ */
+bool packBoard(const unsigned char* cells,packedBoard& packed);
+
+/*! \brief Unpack a 4x4 position.
+ * 
+ *  \param packed The packed position.
+ *  \param cells The 16 cell exponents, stored row by row.
+ */
+void unpackBoard(const packedBoard packed,unsigned char* cells);
+
+/*! \brief Swap rows and columns of a packed position.
+ * 
+ *  \param packed The packed position.
+ *  \return The transposed position.
+ */
+packedBoard transposePacked(const packedBoard packed);
+
+/*! \brief Move a packed position with four table lookups.
+ * 
+ *  Slides and merges like movePosition(), without the game rules of board::move().
+ * 
+ *  \param packed The packed position.
+ *  \param direction The direction in which to move the cells.
+ *  \param result The position after the move.
+ *  \param score The score that needs updating.
+ *  \return Whether the result fits into the packed representation. If not,
+ *  result and score are left unchanged.
+ */
+bool movePacked(const packedBoard packed,const char direction,packedBoard& result,unsigned& score);
+
+#endif // PACKED_H
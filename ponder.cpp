@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file ponder.cpp
+ * \brief File contains the implementation of background pondering and the
+ * assisted keyboard input that answers hints from the warm cache.
+ * 
+ */
+
+#include "ponder.h"
+
+ponderer::ponderer(const evaluator& eval,transpositionTable& cache,const unsigned maxDepth)
+    : search(eval), maxDepth(maxDepth), busy(false), stopping(false), ponderedDepth(0)
+{
+    this->search.setCache(&cache);
+    this->worker = std::thread(&ponderer::work,this);
+}
+
+ponderer::~ponderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        this->search.interrupt();
+    }
+    this->condition.notify_all();
+    this->worker.join();
+}
+
+void ponderer::start(const board& gameBoard)
+{
+    this->stop();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->position.reset(new board(gameBoard));
+        this->ponderedDepth = 0;
+    }
+    this->condition.notify_all();
+}
+
+void ponderer::stop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->position.reset();
+    this->search.interrupt();
+    this->condition.wait(lock,[this]() { return !this->busy; });
+}
+
+unsigned ponderer::getPonderedDepth()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->ponderedDepth;
+}
+
+void ponderer::work()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while(1) {
+        this->condition.wait(lock,[this]() { return this->stopping || this->position; });
+        if(this->stopping) return;
+
+        std::unique_ptr<board> current(std::move(this->position));
+        // Cleared under the lock, so an interrupt() of a later stop() is never lost.
+        this->search.clearInterrupt();
+        this->busy = true;
+        lock.unlock();
+
+        // Ponder until interrupted, the deadline is only a safety net.
+        searchResult result = this->search.searchUntil(*current,std::chrono::steady_clock::now() + std::chrono::hours(1),this->maxDepth);
+
+        lock.lock();
+        this->busy = false;
+        if(!this->search.isInterrupted()) this->ponderedDepth = result.depth;
+        this->condition.notify_all();
+    }
+}
+
+assistedInput::assistedInput(inputSource& keys,ponderer& background,expectimaxSearch& hints,const std::chrono::milliseconds hintTime,
+                             const std::function<void(const searchResult&)>& showHint)
+    : keys(keys), background(background), hints(hints), hintTime(hintTime), showHint(showHint)
+{
+}
+
+bool assistedInput::nextKey(const board& gameBoard,char& key)
+{
+    this->background.start(gameBoard);
+    while(1) {
+        // Keep pondering while the input is suspended.
+        if(!this->keys.nextKey(gameBoard,key)) return false;
+        this->background.stop();
+        if(key != HINT && key != AUTOMOVE) return true;
+
+        searchResult hint = this->hints.searchUntil(gameBoard,std::chrono::steady_clock::now() + this->hintTime);
+        if(key == AUTOMOVE && hint.move != QUIT) {
+            key = hint.move;
+            return true;
+        }
+        if(this->showHint) this->showHint(hint);
+        this->background.start(gameBoard);
+    }
+}
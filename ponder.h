@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file ponder.h
+ * \brief File contains the definition of background pondering and the assisted
+ * keyboard input that answers hints from the warm cache.
+ * 
+ */
+
+#ifndef PONDER_H
+#define PONDER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "board.h"
+#include "cache.h"
+#include "search.h"
+#include "session.h"
+
+/*! \brief Searches the current position on a background thread.
+ *
+ *  While the player thinks, the position is searched deeper and deeper. Every
+ *  pass visits all four moves and all their spawns, i.e. every position the
+ *  player can face next, and leaves the values of their chance nodes in the
+ *  shared transposition table. A hint search with the same table then finds
+ *  most of its work already done.
+ */
+class ponderer
+{
+private:
+    expectimaxSearch search; /*!< The background search, shares the transposition table. */
+    unsigned maxDepth; /*!< The deepest pass. */
+    std::unique_ptr<board> position; /*!< The position waiting to be searched (NULL if none). */
+    bool busy; /*!< Whether the worker is searching. */
+    bool stopping; /*!< Whether the worker has to exit. */
+    unsigned ponderedDepth; /*!< The depth of the last completed background search. */
+    std::mutex mutex; /*!< Protects the position and the flags. */
+    std::condition_variable condition; /*!< Signals a new position, the end of a search or stopping. */
+    std::thread worker; /*!< Runs the background search. */
+
+    /*! \brief The loop of the background thread. */
+    void work();
+
+public:
+    /*! \brief Start the background thread.
+     * 
+     *  \param eval Scores the leaves, must be the evaluator of the hint search.
+     *  \param cache The transposition table shared with the hint search.
+     *  \param maxDepth The deepest pass.
+     */
+    ponderer(const evaluator& eval,transpositionTable& cache,const unsigned maxDepth = 8);
+
+    ~ponderer(); /*!< Stop the background thread. */
+
+    /*! \brief Start searching a position, the previous search is stopped.
+     * 
+     *  \param gameBoard The position.
+     */
+    void start(const board& gameBoard);
+
+    /*! \brief Stop searching and wait until the background thread is idle. */
+    void stop();
+
+    /*! \brief Get the depth of the last completed background search.
+     * 
+     *  \return The depth (0 while searching or if nothing was searched yet).
+     */
+    unsigned getPonderedDepth();
+};
+
+/*! \brief Keyboard input with hints and automatic moves.
+ *
+ *  Ponders while waiting for the next key. HINT shows the best move, AUTOMOVE
+ *  plays it, all other keys are passed on. Suspends if the wrapped input
+ *  suspends, pondering goes on in the meantime.
+ */
+class assistedInput : public inputSource
+{
+private:
+    inputSource& keys; /*!< Delivers the keys, including HINT and AUTOMOVE. */
+    ponderer& background; /*!< Ponders while waiting for a key. */
+    expectimaxSearch& hints; /*!< Answers hints, uses the cache of the ponderer. */
+    std::chrono::milliseconds hintTime; /*!< The time limit of a hint search. */
+    std::function<void(const searchResult&)> showHint; /*!< Displays a hint. */
+
+public:
+    /*! \brief Make an assisted input.
+     * 
+     *  \param keys Delivers the keys, including HINT and AUTOMOVE.
+     *  \param background Ponders while waiting for a key.
+     *  \param hints Answers hints, has to use the cache of the ponderer.
+     *  \param hintTime The time limit of a hint search.
+     *  \param showHint Displays a hint.
+     */
+    assistedInput(inputSource& keys,ponderer& background,expectimaxSearch& hints,const std::chrono::milliseconds hintTime,
+                  const std::function<void(const searchResult&)>& showHint);
+
+    bool nextKey(const board& gameBoard,char& key);
+};
+
+#endif // PONDER_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file position.cpp
+ * \brief File contains the implementation of functions that work directly on
+ * the cell exponents of a position.
+ * 
+ */
+
+#include "position.h"
+#include "packed.h"
+
+// Move a 4x4 position with one line table lookup per line. Returns false, without
+// touching the score, if an exponent does not fit into the tables.
+static bool movePositionTable(const unsigned char* cells,unsigned char* result,const int first,const int lineStep,const int cellStep,bool& changed,unsigned& score)
+{
+    const lineTables& tables = getLineTables();
+    unsigned moveScore = 0;
+    changed = false;
+    for(unsigned i = 0; i < 4; ++i) {
+        const int lineStart = first + int(i)*lineStep;
+        unsigned index = 0;
+        for(unsigned k = 0; k < 4; ++k) {
+            unsigned char exponent = cells[lineStart + int(k)*cellStep];
+            if(exponent > 15) return false;
+            index |= unsigned(exponent) << (4*k);
+        }
+        if(tables.scoreLow[index] == lineOverflow) return false;
+        moveScore += tables.scoreLow[index];
+        uint16_t moved = tables.towardLow[index];
+        if(moved != index) changed = true;
+        for(unsigned k = 0; k < 4; ++k) result[lineStart + int(k)*cellStep] = (moved >> (4*k)) & 0xf;
+    }
+    score += moveScore;
+    return true;
+}
+
+bool movePosition(const unsigned char* cells,unsigned char* result,const unsigned size,const char direction,unsigned& score)
+{
+    // Cell k of line i is at first + i*lineStep + k*cellStep, k = 0 being the cell the line moves to.
+    int first,lineStep,cellStep;
+    switch(direction) {
+        case UP:
+            first = 0; lineStep = size; cellStep = 1;
+            break;
+        case DOWN:
+            first = size-1; lineStep = size; cellStep = -1;
+            break;
+        case LEFT:
+            first = 0; lineStep = 1; cellStep = size;
+            break;
+        default: // RIGHT
+            assert(direction == RIGHT);
+            first = (size-1)*size; lineStep = 1; cellStep = -int(size);
+            break;
+    }
+
+    bool changed = false;
+    if(size == 4 && movePositionTable(cells,result,first,lineStep,cellStep,changed,score)) return changed;
+    changed = false;
+
+    for(unsigned i = 0; i < size; ++i) {
+        const int lineStart = first + int(i)*lineStep;
+        unsigned nOut = 0;
+        unsigned char pending = 0;
+
+        // Merge pairs starting at the side the line moves to, like combineCells().
+        for(unsigned k = 0; k < size; ++k) {
+            unsigned char exponent = cells[lineStart + int(k)*cellStep];
+            if(exponent == 0) continue;
+            if(pending == 0) {
+                pending = exponent;
+            }
+            else if(pending == exponent) {
+                result[lineStart + int(nOut++)*cellStep] = exponent + 1;
+                score += tileValue(exponent + 1);
+                pending = 0;
+            }
+            else {
+                result[lineStart + int(nOut++)*cellStep] = pending;
+                pending = exponent;
+            }
+        }
+        if(pending != 0) result[lineStart + int(nOut++)*cellStep] = pending;
+        for(unsigned k = nOut; k < size; ++k) result[lineStart + int(k)*cellStep] = 0;
+
+        for(unsigned k = 0; k < size && !changed; ++k) {
+            if(result[lineStart + int(k)*cellStep] != cells[lineStart + int(k)*cellStep]) changed = true;
+        }
+    }
+    return changed;
+}
+
+unsigned countEmptyCells(const unsigned char* cells,const unsigned size)
+{
+    unsigned nEmpty = 0;
+    for(unsigned i = 0; i < size*size; ++i) if(cells[i] == 0) ++nEmpty;
+    return nEmpty;
+}
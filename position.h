@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file position.h
+ * \brief File contains the definition of functions that work directly on the
+ * cell exponents of a position, without a board object.
+ * 
+ */
+
+#ifndef POSITION_H
+#define POSITION_H
+
+#include "helper.h"
+
+/*! \brief Move the cells of a position.
+ * 
+ *  Slide and merge all lines of a position like board::move(), but without the
+ *  game rules around it: no check for a full board and no win detection. The
+ *  input and output must not overlap.
+ * 
+ *  \param cells The size*size cell exponents of the position, stored row by row.
+ *  \param result The size*size cell exponents after the move.
+ *  \param size The number of rows and columns.
+ *  \param direction The direction in which to move the cells.
+ *  \param score The score that needs updating.
+ *  \return Whether any cell changed.
+ */
+bool movePosition(const unsigned char* cells,unsigned char* result,const unsigned size,const char direction,unsigned& score);
+
+/*! \brief Count the empty cells of a position.
+ * 
+ *  \param cells The size*size cell exponents of the position.
+ *  \param size The number of rows and columns.
+ *  \return The number of empty cells.
+ */
+unsigned countEmptyCells(const unsigned char* cells,const unsigned size);
+
+#endif // POSITION_H
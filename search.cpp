@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file search.cpp
+ * \brief File contains the implementation of the expectimax search.
+ * 
+ */
+
+#include "search.h"
+#include "position.h"
+#include "helper.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+// Order in which moves are searched.
+static const char directions[4] = {UP,DOWN,LEFT,RIGHT};
+
+expectimaxSearch::expectimaxSearch(const evaluator& eval,const double lossValue)
+    : eval(eval), lossValue(lossValue), pool(NULL), splitDepth(2), cache(NULL), endgame(NULL), nodes(0), arenaPeak(0), aborted(false), interrupted(false), hasDeadline(false)
+{
+}
+
+void expectimaxSearch::setThreadPool(threadPool* pool,const unsigned splitDepth)
+{
+    this->pool = pool;
+    this->splitDepth = splitDepth;
+}
+
+void expectimaxSearch::setCache(transpositionTable* cache)
+{
+    this->cache = cache;
+}
+
+void expectimaxSearch::setTablebase(const tablebase* endgame)
+{
+    this->endgame = endgame;
+}
+
+bool expectimaxSearch::probeTablebase(const board& gameBoard,searchResult& result) const
+{
+    // The table holds the chance of reaching its own target tile, which only
+    // answers boards that play to that tile and have not reached it yet.
+    if(!this->endgame || gameBoard.hasWon() || this->endgame->getTargetExponent() != tileExponent(gameBoard.getWinTile())) return false;
+    const unsigned char* cells = gameBoard.getExponents().data();
+    if(!this->endgame->covers(cells,gameBoard.getSize())) return false;
+    result.move = this->endgame->bestMove(cells,result.value);
+    result.nodes = 0;
+    result.arenaPeak = 0;
+    result.depth = 0;
+    result.fromTablebase = true;
+    return true;
+}
+
+void expectimaxSearch::updateArenaPeak()
+{
+    std::size_t peak = arena::threadArena().getPeakUsage();
+    std::size_t known = this->arenaPeak.load();
+    while(peak > known && !this->arenaPeak.compare_exchange_weak(known,peak)) {
+    }
+}
+
+bool expectimaxSearch::countNode()
+{
+    // Look at the clock only every 256 nodes, it is much slower than a node.
+    unsigned long n = this->nodes.fetch_add(1,std::memory_order_relaxed);
+    if(this->hasDeadline && (this->interrupted.load(std::memory_order_relaxed)
+                             || ((n & 255) == 0 && std::chrono::steady_clock::now() >= this->deadline))) this->aborted = true;
+    return !this->aborted.load(std::memory_order_relaxed);
+}
+
+double expectimaxSearch::maxNode(const unsigned char* cells,const unsigned size,const unsigned depth,arena& memory)
+{
+    if(!this->countNode()) return 0.0;
+
+    // A full board loses the game, like in board::move().
+    if(countEmptyCells(cells,size) == 0) return this->lossValue;
+
+    arena::marker start = memory.mark();
+    unsigned char* result = memory.allocateArray<unsigned char>(size*size);
+    double bestValue = this->lossValue;
+    for(const char direction : directions) {
+        unsigned reward = 0;
+        if(!movePosition(cells,result,size,direction,reward)) continue;
+        bestValue = std::max(bestValue,reward + this->chanceNode(result,size,depth-1,memory));
+    }
+    memory.rewind(start);
+    return bestValue;
+}
+
+double expectimaxSearch::chanceNode(const unsigned char* cells,const unsigned size,const unsigned depth,arena& memory)
+{
+    if(!this->countNode()) return 0.0;
+    if(depth == 0) return this->eval.evaluate(cells,size);
+
+    double value;
+    uint64_t key = 0;
+    if(this->cache) {
+        key = transpositionTable::hashPosition(cells,size);
+        if(this->cache->lookup(key,depth,value)) return value;
+    }
+
+    arena::marker start = memory.mark();
+    unsigned nEmpty = countEmptyCells(cells,size);
+
+    // A valid move always leaves at least one empty cell.
+    assert(nEmpty > 0);
+
+    // A 2 spawns with 90 % and a 4 with 10 % probability, see generateCellValue().
+    value = 0.0;
+    if(this->pool && depth >= this->splitDepth) {
+        // Build all children up front and search them as parallel tasks. The
+        // children stay valid until the rewind below, after all tasks are done.
+        unsigned nChildren = 2*nEmpty;
+        unsigned char* children = memory.allocateArray<unsigned char>(nChildren*size*size);
+        double* childValues = memory.allocateArray<double>(nChildren);
+        taskGroup group(*this->pool);
+        unsigned k = 0;
+        for(unsigned i = 0; i < size*size; ++i) {
+            if(cells[i] != 0) continue;
+            for(unsigned char exponent = 1; exponent <= 2; ++exponent, ++k) {
+                unsigned char* child = children + k*size*size;
+                std::copy(cells,cells+size*size,child);
+                child[i] = exponent;
+                double* childValue = childValues + k;
+                group.run([this,child,childValue,size,depth]() {
+                    *childValue = this->maxNode(child,size,depth,arena::threadArena());
+                    this->updateArenaPeak();
+                });
+            }
+        }
+        group.wait();
+
+        // Sum in a fixed order so that the result does not depend on scheduling.
+        for(k = 0; k < nChildren; k += 2) value += 0.9*childValues[k] + 0.1*childValues[k+1];
+    }
+    else {
+        unsigned char* child = memory.allocateArray<unsigned char>(size*size);
+        std::copy(cells,cells+size*size,child);
+        for(unsigned i = 0; i < size*size; ++i) {
+            if(cells[i] != 0) continue;
+            child[i] = 1;
+            double valueTwo = this->maxNode(child,size,depth,memory);
+            child[i] = 2;
+            double valueFour = this->maxNode(child,size,depth,memory);
+            child[i] = 0;
+            value += 0.9*valueTwo + 0.1*valueFour;
+        }
+    }
+    memory.rewind(start);
+    value /= nEmpty;
+
+    // Values of an aborted pass are incomplete and must not be cached.
+    if(this->cache && !this->aborted) this->cache->store(key,depth,value);
+    return value;
+}
+
+bool expectimaxSearch::searchRoot(const unsigned char* cells,const unsigned size,const unsigned depth,const unsigned order[4],double values[4],bool isValid[4],arena& memory)
+{
+    arena::marker start = memory.mark();
+
+    // Search the root moves in the given order, as parallel tasks if there is a pool.
+    unsigned char* results = memory.allocateArray<unsigned char>(4*size*size);
+    std::unique_ptr<taskGroup> group(this->pool ? new taskGroup(*this->pool) : NULL);
+    for(unsigned i = 0; i < 4; ++i) {
+        unsigned d = order[i];
+        unsigned char* result = results + d*size*size;
+        unsigned reward = 0;
+        isValid[d] = movePosition(cells,result,size,directions[d],reward);
+        if(!isValid[d]) continue;
+        double* value = values + d;
+        if(group) {
+            group->run([this,result,value,reward,size,depth]() {
+                *value = reward + this->chanceNode(result,size,depth-1,arena::threadArena());
+                this->updateArenaPeak();
+            });
+        }
+        else {
+            *value = reward + this->chanceNode(result,size,depth-1,memory);
+        }
+    }
+    if(group) group->wait();
+    this->updateArenaPeak();
+    memory.rewind(start);
+
+    return !this->aborted;
+}
+
+searchResult expectimaxSearch::search(const board& gameBoard,const unsigned depth)
+{
+    assert(depth > 0);
+
+    searchResult exact;
+    if(this->probeTablebase(gameBoard,exact)) return exact;
+
+    arena::threadArena().reset();
+    this->nodes = 0;
+    this->arenaPeak = 0;
+    this->aborted = false;
+    this->hasDeadline = false;
+
+    const unsigned order[4] = {0,1,2,3};
+    double values[4];
+    bool isValid[4];
+    this->searchRoot(gameBoard.getExponents().data(),gameBoard.getSize(),depth,order,values,isValid,arena::threadArena());
+    return this->makeResult(values,isValid,depth);
+}
+
+searchResult expectimaxSearch::searchUntil(const board& gameBoard,const std::chrono::steady_clock::time_point deadline,const unsigned maxDepth)
+{
+    assert(maxDepth > 0);
+
+    searchResult exact;
+    if(this->probeTablebase(gameBoard,exact)) return exact;
+
+    arena::threadArena().reset();
+    this->nodes = 0;
+    this->arenaPeak = 0;
+    this->deadline = deadline;
+
+    const unsigned char* cells = gameBoard.getExponents().data();
+    const unsigned size = gameBoard.getSize();
+    unsigned order[4] = {0,1,2,3};
+    double values[4];
+    bool isValid[4];
+    searchResult best = this->makeResult(values,isValid,0);
+    for(unsigned depth = 1; depth <= maxDepth; ++depth) {
+        // The first pass is never aborted, so that there always is a move.
+        this->aborted = false;
+        this->hasDeadline = depth > 1;
+        if(!this->searchRoot(cells,size,depth,order,values,isValid,arena::threadArena())) break;
+        best = this->makeResult(values,isValid,depth);
+
+        // Stop early if the move is forced or the time is up.
+        if(std::count(isValid,isValid+4,true) <= 1 || std::chrono::steady_clock::now() >= deadline || this->interrupted) break;
+
+        // Search the best moves of this pass first in the next one.
+        std::stable_sort(order,order+4,[&values,&isValid](const unsigned a,const unsigned b) {
+            if(isValid[a] != isValid[b]) return isValid[a];
+            return isValid[a] && values[a] > values[b];
+        });
+    }
+    best.nodes = this->nodes;
+    best.arenaPeak = this->arenaPeak;
+    return best;
+}
+
+void expectimaxSearch::interrupt()
+{
+    this->interrupted = true;
+}
+
+void expectimaxSearch::clearInterrupt()
+{
+    this->interrupted = false;
+}
+
+bool expectimaxSearch::isInterrupted() const
+{
+    return this->interrupted;
+}
+
+searchResult expectimaxSearch::makeResult(const double values[4],const bool isValid[4],const unsigned depth)
+{
+    // Ties go to the first direction, independent of the order the moves were searched in.
+    searchResult best;
+    best.move = QUIT;
+    best.value = -std::numeric_limits<double>::infinity();
+    best.depth = depth;
+    best.fromTablebase = false;
+    for(unsigned d = 0; depth > 0 && d < 4; ++d) {
+        if(isValid[d] && values[d] > best.value) {
+            best.value = values[d];
+            best.move = directions[d];
+        }
+    }
+    best.nodes = this->nodes;
+    best.arenaPeak = this->arenaPeak;
+    return best;
+}
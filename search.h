@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file search.h
+ * \brief File contains the definition of the expectimax search that chooses
+ * moves by looking ahead over moves and random spawns.
+ * 
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include "arena.h"
+#include "board.h"
+#include "cache.h"
+#include "evaluator.h"
+#include "tablebase.h"
+#include "threadpool.h"
+
+/*! \brief The outcome of a move decision.
+ *
+ */
+struct searchResult
+{
+    char move; /*!< The best move (QUIT if there is no valid move). */
+    double value; /*!< The expected value of the best move. */
+    unsigned long nodes; /*!< The number of searched nodes. */
+    std::size_t arenaPeak; /*!< The largest peak arena usage of all searching threads in bytes. */
+    unsigned depth; /*!< The depth of the deepest completed search pass. */
+    bool fromTablebase; /*!< Whether the move comes from a tablebase, value is then the win probability. */
+};
+
+/*! \brief Expectimax search over moves (max nodes) and spawns (chance nodes).
+ *
+ *  A spawn is a 2 (90 %) or a 4 (10 %) in any empty cell. The leaves are scored
+ *  by an evaluator. All temporary positions are taken from the arena of the
+ *  searching thread, which is reset at the start of every decision.
+ *
+ *  With a thread pool the root moves and the spawns of chance nodes with enough
+ *  depth left are searched as parallel tasks. With a transposition table the
+ *  values of chance nodes are shared between all threads and decisions.
+ *
+ *  searchUntil() deepens iteratively until a deadline and then returns the best
+ *  move of the deepest completed pass.
+ *
+ *  Positions covered by a tablebase are not searched, the exact best move is
+ *  looked up instead.
+ */
+class expectimaxSearch
+{
+private:
+    const evaluator& eval; /*!< Scores the leaves. */
+    double lossValue; /*!< The value of a full board, which loses the game. */
+    threadPool* pool; /*!< Runs parallel tasks (NULL = serial search). */
+    unsigned splitDepth; /*!< Chance nodes with at least this depth left are split into tasks. */
+    transpositionTable* cache; /*!< Shared values of chance nodes (NULL = no cache). */
+    const tablebase* endgame; /*!< Exact values of small positions (NULL = always search). */
+    std::atomic<unsigned long> nodes; /*!< Nodes searched in the current decision. */
+    std::atomic<std::size_t> arenaPeak; /*!< The largest arena peak of all searching threads. */
+    std::atomic<bool> aborted; /*!< Whether the current pass ran out of time or was interrupted. */
+    std::atomic<bool> interrupted; /*!< Whether searchUntil() has to return as soon as possible. */
+    bool hasDeadline; /*!< Whether the current pass can be aborted. */
+    std::chrono::steady_clock::time_point deadline; /*!< When the current pass is aborted. */
+
+    /*! \brief Count a searched node and check the deadline.
+     * 
+     *  \return Whether the search goes on.
+     */
+    bool countNode();
+
+    /*! \brief Search all root moves to a fixed depth.
+     * 
+     *  \param cells The cell exponents of the root.
+     *  \param size The number of rows and columns.
+     *  \param depth The number of moves to look ahead.
+     *  \param order The order in which to search the four directions.
+     *  \param values The value of every direction.
+     *  \param isValid Whether every direction is a valid move.
+     *  \param memory The arena for temporary positions.
+     *  \return Whether the pass completed before the deadline.
+     */
+    bool searchRoot(const unsigned char* cells,const unsigned size,const unsigned depth,const unsigned order[4],double values[4],bool isValid[4],arena& memory);
+
+    /*! \brief Pick the best root move.
+     * 
+     *  \param values The value of every direction.
+     *  \param isValid Whether every direction is a valid move.
+     *  \param depth The depth of the pass (0 = no pass, QUIT).
+     *  \return The best move and search statistics.
+     */
+    searchResult makeResult(const double values[4],const bool isValid[4],const unsigned depth);
+
+    /*! \brief Look up the best move in the tablebase.
+     * 
+     *  \param gameBoard The current board.
+     *  Only boards that play to the target tile of the tablebase and have not
+     *  won yet are looked up.
+     * 
+     *  \param result The best move, if the board is covered by the tablebase.
+     *  \return Whether the board is covered by the tablebase.
+     */
+    bool probeTablebase(const board& gameBoard,searchResult& result) const;
+
+    /*! \brief Record the arena peak of the calling thread. */
+    void updateArenaPeak();
+
+    /*! \brief Value of a position in which the player moves.
+     * 
+     *  \param cells The cell exponents.
+     *  \param size The number of rows and columns.
+     *  \param depth The number of moves left to search.
+     *  \param memory The arena for temporary positions.
+     *  \return The value of the best move.
+     */
+    double maxNode(const unsigned char* cells,const unsigned size,const unsigned depth,arena& memory);
+
+    /*! \brief Value of a position after a move, before the spawn.
+     * 
+     *  \param cells The cell exponents.
+     *  \param size The number of rows and columns.
+     *  \param depth The number of moves left to search.
+     *  \param memory The arena for temporary positions.
+     *  \return The expected value over all spawns.
+     */
+    double chanceNode(const unsigned char* cells,const unsigned size,const unsigned depth,arena& memory);
+
+public:
+    /*! \brief Make a new search.
+     * 
+     *  \param eval Scores the leaves.
+     *  \param lossValue The value of a full board, which loses the game.
+     */
+    expectimaxSearch(const evaluator& eval,const double lossValue = -1e6);
+
+    /*! \brief Search in parallel.
+     * 
+     *  \param pool Runs the parallel tasks (NULL = serial search).
+     *  \param splitDepth Chance nodes with at least this depth left are split into tasks.
+     */
+    void setThreadPool(threadPool* pool,const unsigned splitDepth = 2);
+
+    /*! \brief Share chance node values through a transposition table.
+     * 
+     *  The table must only be shared by searches with the same evaluator and loss value.
+     * 
+     *  \param cache The table (NULL = no cache).
+     */
+    void setCache(transpositionTable* cache);
+
+    /*! \brief Look up positions in a tablebase instead of searching them.
+     * 
+     *  \param endgame The tablebase (NULL = always search).
+     */
+    void setTablebase(const tablebase* endgame);
+
+    /*! \brief Choose a move.
+     * 
+     *  \param gameBoard The current board.
+     *  \param depth The number of moves to look ahead (at least 1).
+     *  \return The best move and search statistics.
+     */
+    searchResult search(const board& gameBoard,const unsigned depth);
+
+    /*! \brief Choose a move within a time limit.
+     * 
+     *  Search to depth 1, 2, 3, ... until the deadline or maxDepth is reached.
+     *  Every pass searches the best moves of the previous one first. Cached
+     *  values are reused if they were searched at least as deep as needed, e.g.
+     *  those left by pondering or an earlier search of the same position; the
+     *  values of the previous pass are one move too shallow, so only the move
+     *  order carries over from it. A pass that runs out of time is abandoned.
+     *  Depth 1 is always completed, so that there is a move even if the deadline
+     *  has passed.
+     * 
+     *  \param gameBoard The current board.
+     *  \param deadline When to stop searching.
+     *  \param maxDepth The deepest pass to search.
+     *  \return The best move of the deepest completed pass and search statistics.
+     */
+    searchResult searchUntil(const board& gameBoard,const std::chrono::steady_clock::time_point deadline,const unsigned maxDepth = 32);
+
+    /*! \brief Make searchUntil() return as if its deadline had passed.
+     * 
+     *  Can be called from any thread, also before searchUntil() starts. The
+     *  search stays interrupted until clearInterrupt() is called.
+     */
+    void interrupt();
+
+    /*! \brief Let searchUntil() run until its deadline again. */
+    void clearInterrupt();
+
+    /*! \brief Check whether the search is interrupted.
+     * 
+     *  \return Whether interrupt() was called after the last clearInterrupt().
+     */
+    bool isInterrupted() const;
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file server.cpp
+ * \brief File contains the implementation of the local game server.
+ * 
+ */
+
+#include "server.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+void appendServerReply(const std::vector<unsigned char>& before,const std::vector<unsigned char>& after,const gameState_t moveState,const unsigned score,std::string& out)
+{
+    assert(before.size() == after.size());
+    assert(after.size() <= 255);
+
+    out.push_back(char(moveState));
+    out.push_back(char((score >> 24) & 0xff));
+    out.push_back(char((score >> 16) & 0xff));
+    out.push_back(char((score >> 8) & 0xff));
+    out.push_back(char(score & 0xff));
+
+    // Reserve the change counter and fill it in after the changes are known.
+    std::string::size_type counterPos = out.size();
+    out.push_back(0);
+    unsigned char nChanges = 0;
+    for(unsigned i = 0; i < after.size(); ++i) {
+        if(before[i] != after[i]) {
+            out.push_back(char(i));
+            out.push_back(char(after[i]));
+            ++nChanges;
+        }
+    }
+    out[counterPos] = char(nChanges);
+}
+
+serverSession::serverSession() : game(4,NULL,0), started(false), watchedEvents(EPOLLIN)
+{
+}
+
+server::server(const std::string& socketPath) : socketPath(socketPath), listenFd(-1), epollFd(-1), stopFd(-1), nSessions(0)
+{
+    std::random_device rd;
+    this->seeder.seed(rd());
+}
+
+server::~server()
+{
+    while(!this->sessions.empty()) this->closeConnection(this->sessions.begin()->first);
+    if(this->listenFd >= 0) {
+        close(this->listenFd);
+        unlink(this->socketPath.c_str());
+    }
+    if(this->stopFd >= 0) close(this->stopFd);
+    if(this->epollFd >= 0) close(this->epollFd);
+}
+
+bool server::start()
+{
+    struct sockaddr_un address;
+    if(this->socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << this->socketPath << std::endl;
+        return false;
+    }
+
+    // Create the listening socket, replacing a stale socket file.
+    this->listenFd = socket(AF_UNIX,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+    if(this->listenFd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path,this->socketPath.c_str(),sizeof(address.sun_path)-1);
+    unlink(this->socketPath.c_str());
+    if(bind(this->listenFd,(struct sockaddr*)&address,sizeof(address)) < 0 || listen(this->listenFd,SOMAXCONN) < 0) {
+        std::cerr << "bind/listen " << this->socketPath << ": " << std::strerror(errno) << std::endl;
+        close(this->listenFd);
+        this->listenFd = -1;
+        return false;
+    }
+
+    // Register the listening socket and the stop event with epoll.
+    this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    this->stopFd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+    if(this->epollFd < 0 || this->stopFd < 0) {
+        std::cerr << "epoll/eventfd: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = this->listenFd;
+    epoll_ctl(this->epollFd,EPOLL_CTL_ADD,this->listenFd,&event);
+    event.data.fd = this->stopFd;
+    epoll_ctl(this->epollFd,EPOLL_CTL_ADD,this->stopFd,&event);
+    return true;
+}
+
+bool server::run()
+{
+    assert(this->epollFd >= 0);
+
+    const int maxEvents = 256;
+    struct epoll_event events[maxEvents];
+    while(1) {
+        int nEvents = epoll_wait(this->epollFd,events,maxEvents,-1);
+        if(nEvents < 0) {
+            if(errno == EINTR) continue;
+            std::cerr << "epoll_wait: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        for(int i = 0; i < nEvents; ++i) {
+            int fd = events[i].data.fd;
+            if(fd == this->stopFd) {
+                return true;
+            }
+            else if(fd == this->listenFd) {
+                this->acceptConnections();
+            }
+            else {
+                bool isOpen = true;
+                if(events[i].events & (EPOLLERR | EPOLLHUP)) isOpen = false;
+                if(isOpen && (events[i].events & EPOLLOUT)) isOpen = this->flushOutput(fd);
+                // Requests held back by the output limit are processed once it has been drained.
+                if(isOpen && (events[i].events & (EPOLLIN | EPOLLOUT))) isOpen = this->readRequests(fd);
+                if(!isOpen) this->closeConnection(fd);
+            }
+        }
+    }
+}
+
+void server::stop()
+{
+    uint64_t one = 1;
+    if(write(this->stopFd,&one,sizeof(one)) < 0) {
+        std::cerr << "Could not stop server: " << std::strerror(errno) << std::endl;
+    }
+}
+
+unsigned server::getSessionCount() const
+{
+    return this->nSessions;
+}
+
+void server::acceptConnections()
+{
+    while(1) {
+        int fd = accept4(this->listenFd,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "accept: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(this->epollFd,EPOLL_CTL_ADD,fd,&event);
+        this->sessions.insert(std::make_pair(fd,serverSession()));
+        this->nSessions = this->sessions.size();
+    }
+}
+
+bool server::readRequests(const int fd)
+{
+    serverSession& currentSession = this->sessions.at(fd);
+
+    // Alternate between processing complete requests and reading more, until
+    // the socket is drained or too many replies are pending.
+    char buffer[4096];
+    std::string::size_type pos = 0;
+    bool isOpen = true;
+    while(isOpen) {
+        while(isOpen && pos + 2 <= currentSession.inBuffer.size() && currentSession.outBuffer.size() < serverOutputLimit) {
+            isOpen = this->handleRequest(currentSession,currentSession.inBuffer[pos],currentSession.inBuffer[pos+1]);
+            pos += 2;
+        }
+        if(!isOpen) break;
+        if(currentSession.outBuffer.size() >= serverOutputLimit) {
+            // Continue right away if the client takes the replies, otherwise wait for EPOLLOUT.
+            if(!this->flushOutput(fd)) return false;
+            if(currentSession.outBuffer.size() >= serverOutputLimit) break;
+            continue;
+        }
+        currentSession.inBuffer.erase(0,pos);
+        pos = 0;
+
+        ssize_t nRead = read(fd,buffer,sizeof(buffer));
+        if(nRead > 0) {
+            currentSession.inBuffer.append(buffer,nRead);
+        }
+        else if(nRead == 0) {
+            return false;
+        }
+        else if(errno == EINTR) {
+            continue;
+        }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        else {
+            return false;
+        }
+    }
+    currentSession.inBuffer.erase(0,pos);
+
+    if(!this->flushOutput(fd)) return false;
+    return isOpen;
+}
+
+bool server::handleRequest(serverSession& currentSession,const char opcode,const char argument)
+{
+    std::vector<unsigned char> before;
+    gameState_t moveState;
+
+    switch(opcode) {
+        case SERVER_NEW: {
+            unsigned boardSize = argument == 0 ? 4 : (unsigned char)argument;
+            if(boardSize < 2 || boardSize > 15) return false;
+            currentSession.game = session(boardSize,NULL,this->seeder());
+            currentSession.started = true;
+            before.assign(boardSize*boardSize,0);
+            appendServerReply(before,currentSession.game.getBoard().getExponents(),UNFINISHED,currentSession.game.getScore(),currentSession.outBuffer);
+            return true;
+        }
+        case SERVER_MOVE:
+            if(!currentSession.started) return false;
+            if(argument != UP && argument != DOWN && argument != LEFT && argument != RIGHT) return false;
+            before = currentSession.game.getBoard().getExponents();
+            moveState = currentSession.game.step(argument);
+            appendServerReply(before,currentSession.game.getBoard().getExponents(),moveState,currentSession.game.getScore(),currentSession.outBuffer);
+            return true;
+        default: // SERVER_QUIT and unknown opcodes.
+            return false;
+    }
+}
+
+bool server::flushOutput(const int fd)
+{
+    serverSession& currentSession = this->sessions.at(fd);
+    std::string::size_type pos = 0;
+    while(pos < currentSession.outBuffer.size()) {
+        ssize_t nWritten = send(fd,currentSession.outBuffer.data()+pos,currentSession.outBuffer.size()-pos,MSG_NOSIGNAL);
+        if(nWritten >= 0) {
+            pos += nWritten;
+        }
+        else if(errno == EINTR) {
+            continue;
+        }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        else {
+            return false;
+        }
+    }
+    currentSession.outBuffer.erase(0,pos);
+    this->updateEvents(fd);
+    return true;
+}
+
+void server::updateEvents(const int fd)
+{
+    serverSession& currentSession = this->sessions.at(fd);
+    uint32_t events = 0;
+    if(currentSession.outBuffer.size() < serverOutputLimit) events |= EPOLLIN;
+    if(!currentSession.outBuffer.empty()) events |= EPOLLOUT;
+    if(events != currentSession.watchedEvents) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(this->epollFd,EPOLL_CTL_MOD,fd,&event);
+        currentSession.watchedEvents = events;
+    }
+}
+
+void server::closeConnection(const int fd)
+{
+    epoll_ctl(this->epollFd,EPOLL_CTL_DEL,fd,NULL);
+    close(fd);
+    this->sessions.erase(fd);
+    this->nSessions = this->sessions.size();
+}
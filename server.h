@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file server.h
+ * \brief File contains the definition of the local game server that hosts
+ * many concurrent 2048 sessions over a Unix domain socket.
+ * 
+ * Protocol: the client sends 2-byte requests [opcode][argument]:
+ * - NEW ('n'): start a new game, the argument is the board size (0 = 4).
+ * - MOVE ('m'): make a move, the argument is the direction (w, a, s or d).
+ * - QUIT ('q'): end the session, the server closes the connection.
+ *
+ * Every NEW and MOVE request is answered with a reply
+ * [gameState (1 byte)][score (4 bytes, big endian)][nChanges (1 byte)]
+ * followed by nChanges pairs [cell index][exponent] of the cells that changed,
+ * where the cell index is row*size+col. Boards are limited to 15x15 so that
+ * cell indices and the number of changes fit into a byte.
+ *
+ * A client has to read its replies: while more than serverOutputLimit bytes of
+ * replies are pending, the server stops reading requests from the connection.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <unordered_map>
+#include "board.h"
+#include "helper.h"
+#include "session.h"
+
+/*! \brief Request opcodes of the server protocol.
+ * 
+ */
+enum { SERVER_NEW = 'n', SERVER_MOVE = 'm', SERVER_QUIT = 'q' };
+
+/*! \brief Pending reply bytes of a connection above which no requests are read.
+ * 
+ */
+const std::size_t serverOutputLimit = 1 << 16;
+
+/*! \brief Append a reply frame to an output buffer.
+ * 
+ *  Encode the game state, the score and all cells that differ between two
+ *  exponent snapshots of the same board.
+ * 
+ *  \param before The cell exponents before the request.
+ *  \param after The cell exponents after the request.
+ *  \param moveState The state of the game.
+ *  \param score The current score.
+ *  \param out The buffer to append the frame to.
+ */
+void appendServerReply(const std::vector<unsigned char>& before,const std::vector<unsigned char>& after,const gameState_t moveState,const unsigned score,std::string& out);
+
+/*! \brief A single game hosted by the server.
+ *
+ */
+struct serverSession
+{
+    session game; /*!< The game, driven by the requests of the connection. */
+    bool started; /*!< Whether a NEW request has been received. */
+    uint32_t watchedEvents; /*!< The epoll events the connection is registered for. */
+    std::string inBuffer; /*!< Received bytes that do not form a full request yet. */
+    std::string outBuffer; /*!< Reply bytes that could not be sent yet. */
+
+    serverSession(); /*!< Make a new session that waits for a NEW request. */
+};
+
+/*! \brief Local game server.
+ *
+ *  Hosts many concurrent games in one process. Connections are multiplexed with
+ *  an epoll event loop on non-blocking sockets, every connection owns one entry
+ *  in the session table.
+ */
+class server
+{
+private:
+    std::string socketPath; /*!< The filesystem path of the Unix domain socket. */
+    int listenFd; /*!< The listening socket. */
+    int epollFd; /*!< The epoll instance. */
+    int stopFd; /*!< The eventfd used to wake up and stop the event loop. */
+    std::mt19937 seeder; /*!< Generates the seeds of new sessions. */
+    std::unordered_map<int,serverSession> sessions; /*!< The session table, indexed by connection. */
+    std::atomic<unsigned> nSessions; /*!< The size of the session table, readable from other threads. */
+
+    /*! \brief Accept all pending connections. */
+    void acceptConnections();
+
+    /*! \brief Read and process the pending requests of a connection.
+     * 
+     *  Stops early while serverOutputLimit bytes of replies are pending, the
+     *  remaining requests are processed once the output has been drained.
+     * 
+     *  \param fd The connection.
+     *  \return Whether the connection is still open.
+     */
+    bool readRequests(const int fd);
+
+    /*! \brief Process one request of a session.
+     * 
+     *  \param currentSession The session.
+     *  \param opcode The request opcode.
+     *  \param argument The request argument.
+     *  \return Whether the session continues.
+     */
+    bool handleRequest(serverSession& currentSession,const char opcode,const char argument);
+
+    /*! \brief Send as much pending output of a connection as possible.
+     * 
+     *  \param fd The connection.
+     *  \return Whether the connection is still open.
+     */
+    bool flushOutput(const int fd);
+
+    /*! \brief Watch a connection for requests while its output is below the
+     *  limit and for writability while output is pending.
+     * 
+     *  \param fd The connection.
+     */
+    void updateEvents(const int fd);
+
+    /*! \brief Close a connection and remove its session. */
+    void closeConnection(const int fd);
+
+public:
+    /*! \brief Make a new server.
+     * 
+     *  \param socketPath The filesystem path of the Unix domain socket.
+     */
+    server(const std::string& socketPath);
+
+    ~server(); /*!< Destructor that closes all connections and removes the socket file. */
+
+    /*! \brief Create, bind and listen on the socket.
+     * 
+     *  \return Whether the server is ready to run.
+     */
+    bool start();
+
+    /*! \brief Run the event loop until stop() is called.
+     * 
+     *  \return Whether the event loop ended without error.
+     */
+    bool run();
+
+    /*! \brief Stop the event loop. Can be called from any thread. */
+    void stop();
+
+    /*! \brief Get the number of open sessions.
+     * 
+     *  \return The number of open sessions.
+     */
+    unsigned getSessionCount() const;
+};
+
+#endif // SERVER_H
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file session.cpp
+ * \brief File contains the implementation of resumable game sessions, their
+ * input sources and the session pool.
+ * 
+ */
+
+#include "session.h"
+
+inputSource::~inputSource()
+{
+}
+
+terminalInput::terminalInput(const bool withAssistKeys) : withAssistKeys(withAssistKeys)
+{
+}
+
+bool terminalInput::nextKey(const board& gameBoard,char& key)
+{
+    key = getActionCommandKey(this->withAssistKeys);
+    return true;
+}
+
+replayInput::replayInput(std::istream& stream) : stream(stream)
+{
+}
+
+bool replayInput::nextKey(const board& gameBoard,char& key)
+{
+    char c;
+    while(this->stream.get(c)) {
+        if(c == UP || c == DOWN || c == LEFT || c == RIGHT || c == QUIT || c == UNDO || c == REDO) {
+            key = c;
+            return true;
+        }
+    }
+
+    // End of the replay.
+    key = QUIT;
+    return true;
+}
+
+policyInput::policyInput(const std::function<char(const board&)>& policy) : policy(policy)
+{
+}
+
+bool policyInput::nextKey(const board& gameBoard,char& key)
+{
+    key = this->policy(gameBoard);
+    return true;
+}
+
+void queueInput::push(const char key)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->keys.push_back(key);
+}
+
+bool queueInput::nextKey(const board& gameBoard,char& key)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if(this->keys.empty()) return false;
+    key = this->keys.front();
+    this->keys.pop_front();
+    return true;
+}
+
+session::session(const unsigned size,inputSource* input,const unsigned seed,const unsigned winTile,const bool continueAfterWin)
+    : gameBoard(size,winTile,continueAfterWin), score(0), mt(seed), input(input), moveState(UNFINISHED),
+      continueAfterWin(continueAfterWin), quit(false), schedulingState(SCHEDULING_IDLE)
+{
+    this->gameBoard.addRandomValue(this->mt);
+}
+
+void session::setObserver(const std::function<void(const session&,const gameState_t)>& observer)
+{
+    this->observer = observer;
+}
+
+gameState_t session::step(const char key)
+{
+    if(key == QUIT) {
+        this->quit = true;
+        return INVALID;
+    }
+    if(key == UNDO || key == REDO) {
+        if(!this->history) return INVALID;
+        bool changed = key == UNDO ? this->history->undo(this->gameBoard,this->score,this->moveState)
+                                   : this->history->redo(this->gameBoard,this->score,this->moveState);
+        if(changed && this->observer) this->observer(*this,INVALID);
+        return INVALID;
+    }
+
+    gameState_t previousState = this->moveState;
+    unsigned previousScore = this->score;
+    bool previouslyWon = this->gameBoard.hasWon();
+    if(this->history) this->previousCells = this->gameBoard.getExponents();
+
+    gameState_t state = this->gameBoard.move(key,this->score);
+    if(state != INVALID) {
+        // Add a new value to the board.
+        this->gameBoard.addRandomValue(this->mt);
+        this->moveState = state;
+        if(this->history) {
+            this->history->record(this->previousCells,this->gameBoard,this->score-previousScore,previousState,state,previouslyWon);
+        }
+        if(this->observer) this->observer(*this,state);
+    }
+    return state;
+}
+
+bool session::enableHistory(const std::size_t maxTurns)
+{
+    const unsigned size = this->gameBoard.getSize();
+    if(size > 255) {
+        std::cerr << "Undo is not available on boards larger than 255x255." << std::endl;
+        return false;
+    }
+    // About 8 changed cells per turn on a 4x4 board, more on larger ones.
+    this->history.reset(new boardHistory(maxTurns,maxTurns*size*2));
+    return true;
+}
+
+const boardHistory* session::getHistory() const
+{
+    return this->history.get();
+}
+
+bool session::resume()
+{
+    assert(this->input != NULL);
+
+    char key;
+    while(!this->isFinished()) {
+        // Suspend if no input is available yet.
+        if(!this->input->nextKey(this->gameBoard,key)) return false;
+        this->step(key);
+    }
+    return true;
+}
+
+bool session::isFinished() const
+{
+    return this->quit || this->moveState == LOOSE || (this->moveState == WIN && !this->continueAfterWin);
+}
+
+bool session::hasQuit() const
+{
+    return this->quit;
+}
+
+gameState_t session::getMoveState() const
+{
+    return this->moveState;
+}
+
+unsigned session::getScore() const
+{
+    return this->score;
+}
+
+const board& session::getBoard() const
+{
+    return this->gameBoard;
+}
+
+void session::write(std::ostream& stream) const
+{
+    this->gameBoard.write(stream);
+    writeBinary(stream,(uint32_t)this->score);
+    writeGenerator(stream,this->mt);
+    writeBinary(stream,(unsigned char)this->moveState);
+    writeBinary(stream,(unsigned char)this->quit);
+}
+
+bool session::read(std::istream& stream)
+{
+    uint32_t storedScore;
+    unsigned char storedState, storedQuit;
+    if(!this->gameBoard.read(stream)) return false;
+    if(!readBinary(stream,storedScore) || !readGenerator(stream,this->mt)) return false;
+    if(!readBinary(stream,storedState) || !readBinary(stream,storedQuit) || storedState > INVALID) return false;
+    this->score = storedScore;
+    this->moveState = gameState_t(storedState);
+    this->quit = storedQuit != 0;
+    return true;
+}
+
+sessionPool::sessionPool(const unsigned nThreads) : nActive(0), stopping(false)
+{
+    assert(nThreads > 0);
+    for(unsigned i = 0; i < nThreads; ++i) this->workers.push_back(std::thread(&sessionPool::work,this));
+}
+
+sessionPool::~sessionPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->readyCondition.notify_all();
+    for(std::thread& worker : this->workers) worker.join();
+}
+
+void sessionPool::add(session& newSession)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        ++this->nActive;
+        newSession.schedulingState = SCHEDULING_QUEUED;
+        this->readyQueue.push_back(&newSession);
+    }
+    this->readyCondition.notify_one();
+}
+
+void sessionPool::wake(session& wokenSession)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        switch(wokenSession.schedulingState) {
+            case SCHEDULING_IDLE:
+                wokenSession.schedulingState = SCHEDULING_QUEUED;
+                this->readyQueue.push_back(&wokenSession);
+                break;
+            case SCHEDULING_RUNNING:
+                // Let the worker resume the session again instead of running it twice at once.
+                wokenSession.schedulingState = SCHEDULING_RUNNING_WOKEN;
+                return;
+            case SCHEDULING_FINISHED:
+                // The game is over and already counted as done, it must not run again.
+                return;
+            default:
+                return;
+        }
+    }
+    this->readyCondition.notify_one();
+}
+
+void sessionPool::waitAll()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while(this->nActive > 0) this->doneCondition.wait(lock);
+}
+
+void sessionPool::work()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while(1) {
+        while(this->readyQueue.empty() && !this->stopping) this->readyCondition.wait(lock);
+        if(this->stopping) return;
+
+        session* currentSession = this->readyQueue.front();
+        this->readyQueue.pop_front();
+        currentSession->schedulingState = SCHEDULING_RUNNING;
+
+        // Run the session without holding the lock.
+        lock.unlock();
+        bool finished = currentSession->resume();
+        lock.lock();
+
+        if(finished) {
+            currentSession->schedulingState = SCHEDULING_FINISHED;
+            if(--this->nActive == 0) this->doneCondition.notify_all();
+        }
+        else if(currentSession->schedulingState == SCHEDULING_RUNNING_WOKEN) {
+            currentSession->schedulingState = SCHEDULING_QUEUED;
+            this->readyQueue.push_back(currentSession);
+        }
+        else {
+            currentSession->schedulingState = SCHEDULING_IDLE;
+        }
+    }
+}
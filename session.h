@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file session.h
+ * \brief File contains the definition of resumable game sessions, their input
+ * sources and the pool that interleaves many sessions on a few threads.
+ * 
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "board.h"
+#include "history.h"
+#include "helper.h"
+
+/*! \brief Source of command keys for a session.
+ *
+ *  An input source either delivers the next command key right away or reports
+ *  that none is available yet, in which case the session suspends until it is
+ *  resumed again.
+ */
+class inputSource
+{
+public:
+    virtual ~inputSource(); /*!< Destructor. */
+
+    /*! \brief Get the next command key.
+     * 
+     *  \param gameBoard The current board, e.g. for policies that compute a move.
+     *  \param key The command key (UP, DOWN, LEFT, RIGHT or QUIT).
+     *  \return Whether a key was available.
+     */
+    virtual bool nextKey(const board& gameBoard,char& key) = 0;
+};
+
+/*! \brief Input from the keyboard via getActionCommandKey(). Never suspends.
+ *
+ */
+class terminalInput : public inputSource
+{
+private:
+    bool withAssistKeys; /*!< Whether HINT and AUTOMOVE are returned as well. */
+public:
+    /*! \brief Make a keyboard input.
+     * 
+     *  \param withAssistKeys Whether to return HINT and AUTOMOVE as well (for an assistedInput).
+     */
+    terminalInput(const bool withAssistKeys = false);
+
+    bool nextKey(const board& gameBoard,char& key);
+};
+
+/*! \brief Input replayed from a stream of command keys. Never suspends.
+ *
+ *  Characters that are not command keys are skipped, the end of the stream quits.
+ */
+class replayInput : public inputSource
+{
+private:
+    std::istream& stream; /*!< The stream to read the keys from. */
+public:
+    /*! \brief Make a new replay input.
+     * 
+     *  \param stream The stream to read the keys from.
+     */
+    replayInput(std::istream& stream);
+
+    bool nextKey(const board& gameBoard,char& key);
+};
+
+/*! \brief Input computed by a policy from the current board. Never suspends.
+ *
+ */
+class policyInput : public inputSource
+{
+private:
+    std::function<char(const board&)> policy; /*!< Maps a board to a command key. */
+public:
+    /*! \brief Make a new policy input.
+     * 
+     *  \param policy Maps a board to a command key.
+     */
+    policyInput(const std::function<char(const board&)>& policy);
+
+    bool nextKey(const board& gameBoard,char& key);
+};
+
+/*! \brief Input pushed by another thread, e.g. from a socket.
+ *
+ *  The session suspends while the queue is empty. The producer has to wake the
+ *  session (see sessionPool::wake()) after pushing keys.
+ */
+class queueInput : public inputSource
+{
+private:
+    std::mutex mutex; /*!< Protects the key queue. */
+    std::deque<char> keys; /*!< Keys that have not been consumed yet. */
+public:
+    /*! \brief Append a key to the queue.
+     * 
+     *  \param key The command key.
+     */
+    void push(const char key);
+
+    bool nextKey(const board& gameBoard,char& key);
+};
+
+/*! \brief Scheduling states of a session inside a sessionPool.
+ * 
+ *  A finished session is never queued again, waking it does nothing.
+ */
+enum schedulingState_t { SCHEDULING_IDLE, SCHEDULING_QUEUED, SCHEDULING_RUNNING, SCHEDULING_RUNNING_WOKEN, SCHEDULING_FINISHED };
+
+/*! \brief A resumable game of 2048.
+ *
+ *  The game loop as a state machine: resume() plays moves until the input source
+ *  has no key available or the game is over, and can be called again later to
+ *  continue where it stopped.
+ */
+class session
+{
+    friend class sessionPool;
+private:
+    board gameBoard; /*!< The board of the game. */
+    unsigned score; /*!< The current score. */
+    std::mt19937 mt; /*!< The random number generator of the game. */
+    inputSource* input; /*!< The source of command keys (may be NULL if only step() is used). */
+    gameState_t moveState; /*!< The state of the game after the last valid move. */
+    bool continueAfterWin; /*!< Whether the game goes on after the win tile has been reached. */
+    bool quit; /*!< Whether the player quit. */
+    std::function<void(const session&,const gameState_t)> observer; /*!< Called after every valid move, undo and redo. */
+    std::unique_ptr<boardHistory> history; /*!< The turns that can be undone (NULL = no undo). */
+    std::vector<unsigned char> previousCells; /*!< The cells before the current move, for the history. */
+    schedulingState_t schedulingState; /*!< Owned by the sessionPool the session runs in. */
+public:
+    /*! \brief Make a new session and add the first value to its board.
+     * 
+     * \param size The number of rows and columns on the board.
+     * \param input The source of command keys (may be NULL if only step() is used).
+     * \param seed The seed of the random number generator.
+     * \param winTile The tile value that wins the game (a power of two).
+     * \param continueAfterWin Whether to keep playing after the win tile was reached.
+     * 
+     */
+    session(const unsigned size,inputSource* input,const unsigned seed,const unsigned winTile = 2048,const bool continueAfterWin = false);
+
+    /*! \brief Set a function that is called after every valid move.
+     * 
+     *  It is also called after an undo or redo, with INVALID as the state.
+     * 
+     *  \param observer Receives the session and the state returned by the move.
+     */
+    void setObserver(const std::function<void(const session&,const gameState_t)>& observer);
+
+    /*! \brief Record every turn so that it can be undone.
+     * 
+     *  The history covers boards of up to 255x255 cells, larger games are
+     *  played without undo.
+     * 
+     *  \param maxTurns The largest number of turns that can be undone.
+     *  \return Whether the history was enabled.
+     */
+    bool enableHistory(const std::size_t maxTurns = 1 << 16);
+
+    /*! \brief Get the undo history.
+     * 
+     *  \return The history (NULL if not enabled).
+     */
+    const boardHistory* getHistory() const;
+
+    /*! \brief Process a single command key.
+     * 
+     *  Make the move, add a new value to the board after every valid move or
+     *  quit the game. UNDO takes back the last turn and REDO repeats it,
+     *  both do nothing without a history.
+     * 
+     *  \param key The command key (UP, DOWN, LEFT, RIGHT, QUIT, UNDO or REDO).
+     *  \return The state returned by the move (INVALID for QUIT).
+     */
+    gameState_t step(const char key);
+
+    /*! \brief Play until the input source suspends or the game is over.
+     * 
+     *  \return Whether the game is over.
+     */
+    bool resume();
+
+    /*! \brief Check whether the game is over.
+     * 
+     *  \return Whether the player quit, lost or won (without "continue after win").
+     */
+    bool isFinished() const;
+
+    /*! \brief Check whether the player quit.
+     * 
+     *  \return Whether the player quit.
+     */
+    bool hasQuit() const;
+
+    /*! \brief Get the state of the game after the last valid move.
+     * 
+     *  \return The state of the game.
+     */
+    gameState_t getMoveState() const;
+
+    /*! \brief Get the current score.
+     * 
+     *  \return The score.
+     */
+    unsigned getScore() const;
+
+    /*! \brief Get the board.
+     * 
+     *  \return The board of the game.
+     */
+    const board& getBoard() const;
+
+    /*! \brief Write the state of the game in a compact binary form.
+     * 
+     *  The board, the score, the random number generator and the game state
+     *  are written, the input source and the observer are not.
+     * 
+     *  \param stream The output stream.
+     */
+    void write(std::ostream& stream) const;
+
+    /*! \brief Continue a game written by write().
+     * 
+     *  \param stream The input stream.
+     *  \return Whether a game of the same board size was read.
+     */
+    bool read(std::istream& stream);
+};
+
+/*! \brief Interleaves many sessions on a small pool of threads.
+ *
+ *  Sessions are resumed by the worker threads until they suspend or finish.
+ *  A suspended session runs again once it is woken with wake().
+ */
+class sessionPool
+{
+private:
+    std::mutex mutex; /*!< Protects the ready queue, the counters and the session scheduling states. */
+    std::condition_variable readyCondition; /*!< Signalled when a session becomes ready. */
+    std::condition_variable doneCondition; /*!< Signalled when a session finishes. */
+    std::deque<session*> readyQueue; /*!< Sessions waiting for a worker. */
+    std::vector<std::thread> workers; /*!< The worker threads. */
+    unsigned nActive; /*!< Sessions added and not finished yet. */
+    bool stopping; /*!< Whether the workers should exit. */
+
+    /*! \brief Main loop of a worker thread. */
+    void work();
+
+public:
+    /*! \brief Make a new pool and start its worker threads.
+     * 
+     *  \param nThreads The number of worker threads.
+     */
+    sessionPool(const unsigned nThreads);
+
+    ~sessionPool(); /*!< Destructor that stops and joins the worker threads. */
+
+    /*! \brief Add a session and schedule it.
+     * 
+     *  \param newSession The session, which has to outlive its time in the pool.
+     */
+    void add(session& newSession);
+
+    /*! \brief Schedule a suspended session again, e.g. after pushing input.
+     * 
+     *  \param wokenSession The session.
+     */
+    void wake(session& wokenSession);
+
+    /*! \brief Block until all added sessions are finished. */
+    void waitAll();
+};
+
+#endif // SESSION_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file sharedring.cpp
+ * \brief File contains the implementation of single-producer/single-consumer
+ * rings of game results in POSIX shared memory.
+ * 
+ */
+
+#include "sharedring.h"
+#include <cassert>
+#include <iostream>
+#include <new>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The counters are shared between processes, which needs address-free lock-free atomics.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,"64-bit atomics have to be lock-free.");
+
+/*! \brief The size of a cache line, the counters get one each to avoid false sharing. */
+static const std::size_t cacheLine = 64;
+
+sharedRings::sharedRings() : nRings(0), capacity(0), ringBytes(0), mapping(NULL), mappingSize(0)
+{
+}
+
+sharedRings::~sharedRings()
+{
+    if(this->mapping) munmap(this->mapping,this->mappingSize);
+}
+
+bool sharedRings::create(const unsigned nRings,const unsigned capacity)
+{
+    assert(this->mapping == NULL);
+    assert(nRings > 0);
+    assert(capacity > 0 && (capacity & (capacity-1)) == 0);
+
+    std::size_t slotBytes = (capacity*sizeof(gameSummary) + cacheLine-1)/cacheLine*cacheLine;
+    std::size_t ringBytes = 2*cacheLine + slotBytes;
+    std::size_t mappingSize = nRings*ringBytes;
+
+    std::string name = "/game2048-rings-" + std::to_string(getpid());
+    int fd = shm_open(name.c_str(),O_RDWR | O_CREAT | O_EXCL,0600);
+    if(fd < 0) {
+        std::cerr << "Cannot create the shared memory " << name << "." << std::endl;
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if(ftruncate(fd,mappingSize) == 0) mapping = mmap(NULL,mappingSize,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    // The mapping stays valid, only forked processes can reach it from now on.
+    shm_unlink(name.c_str());
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        std::cerr << "Cannot map the shared memory " << name << "." << std::endl;
+        return false;
+    }
+
+    this->nRings = nRings;
+    this->capacity = capacity;
+    this->ringBytes = ringBytes;
+    this->mapping = static_cast<unsigned char*>(mapping);
+    this->mappingSize = mappingSize;
+    for(unsigned i = 0; i < nRings; ++i) {
+        new(&this->getCounter(i,0)) std::atomic<uint64_t>(0);
+        new(&this->getCounter(i,1)) std::atomic<uint64_t>(0);
+    }
+    return true;
+}
+
+std::atomic<uint64_t>& sharedRings::getCounter(const unsigned ring,const unsigned counter) const
+{
+    assert(ring < this->nRings);
+    return *reinterpret_cast<std::atomic<uint64_t>*>(this->mapping + ring*this->ringBytes + counter*cacheLine);
+}
+
+gameSummary& sharedRings::getSlot(const unsigned ring,const uint64_t position) const
+{
+    gameSummary* slots = reinterpret_cast<gameSummary*>(this->mapping + ring*this->ringBytes + 2*cacheLine);
+    return slots[position & (this->capacity-1)];
+}
+
+bool sharedRings::push(const unsigned ring,const gameSummary& summary)
+{
+    std::atomic<uint64_t>& tail = this->getCounter(ring,1);
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    if(position - this->getCounter(ring,0).load(std::memory_order_acquire) == this->capacity) return false;
+    this->getSlot(ring,position) = summary;
+    // Publish the slot before the consumer can see the new tail.
+    tail.store(position+1,std::memory_order_release);
+    return true;
+}
+
+bool sharedRings::pop(const unsigned ring,gameSummary& summary)
+{
+    std::atomic<uint64_t>& head = this->getCounter(ring,0);
+    uint64_t position = head.load(std::memory_order_relaxed);
+    if(position == this->getCounter(ring,1).load(std::memory_order_acquire)) return false;
+    summary = this->getSlot(ring,position);
+    // Hand the slot back to the producer only after it has been copied.
+    head.store(position+1,std::memory_order_release);
+    return true;
+}
+
+unsigned sharedRings::getRingCount() const
+{
+    return this->nRings;
+}
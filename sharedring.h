@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file sharedring.h
+ * \brief File contains the definition of single-producer/single-consumer rings
+ * of game results in POSIX shared memory.
+ * 
+ */
+
+#ifndef SHAREDRING_H
+#define SHAREDRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*! \brief The outcome of one game, as published by a worker process. */
+struct gameSummary
+{
+    uint32_t score; /*!< The final score. */
+    uint32_t maxTile; /*!< The largest tile value. */
+    uint32_t nMoves; /*!< The number of valid moves. */
+    uint8_t finalState; /*!< The gameState_t after the last valid move. */
+    uint8_t quit; /*!< Whether the game was quit. */
+};
+
+/*! \brief A set of rings in one shared memory segment, one ring per worker.
+ *
+ *  The segment is created with shm_open() and unlinked right after mapping, so
+ *  it is only reachable by the creating process and the processes it forks
+ *  afterwards, and it disappears with the last of them. Every ring has exactly
+ *  one producer and one consumer, which communicate through two atomic
+ *  counters on separate cache lines without locks or system calls.
+ */
+class sharedRings
+{
+private:
+    unsigned nRings; /*!< The number of rings. */
+    unsigned capacity; /*!< The number of slots of every ring (a power of two). */
+    std::size_t ringBytes; /*!< The size of one ring including its counters. */
+    unsigned char* mapping; /*!< The shared memory (NULL before create()). */
+    std::size_t mappingSize; /*!< The size of the shared memory in bytes. */
+
+    /*! \brief Get the counters of a ring.
+     * 
+     *  \param ring The index of the ring.
+     *  \param counter 0 for the head (next slot to read), 1 for the tail (next slot to write).
+     *  \return The counter.
+     */
+    std::atomic<uint64_t>& getCounter(const unsigned ring,const unsigned counter) const;
+
+    /*! \brief Get a slot of a ring.
+     * 
+     *  \param ring The index of the ring.
+     *  \param position The head or tail counter value.
+     *  \return The slot.
+     */
+    gameSummary& getSlot(const unsigned ring,const uint64_t position) const;
+
+public:
+    sharedRings(); /*!< Make an empty set, call create() before use. */
+    ~sharedRings(); /*!< Unmap the shared memory. */
+
+    /*! \brief Create and map the shared memory of all rings.
+     * 
+     *  \param nRings The number of rings.
+     *  \param capacity The number of slots of every ring (a power of two).
+     *  \return Whether the shared memory was created.
+     */
+    bool create(const unsigned nRings,const unsigned capacity = 4096);
+
+    /*! \brief Append a summary to a ring (producer only).
+     * 
+     *  \param ring The index of the ring.
+     *  \param summary The summary.
+     *  \return Whether there was space in the ring.
+     */
+    bool push(const unsigned ring,const gameSummary& summary);
+
+    /*! \brief Take the oldest summary from a ring (consumer only).
+     * 
+     *  \param ring The index of the ring.
+     *  \param summary Receives the summary.
+     *  \return Whether the ring had a summary.
+     */
+    bool pop(const unsigned ring,gameSummary& summary);
+
+    /*! \brief Get the number of rings.
+     * 
+     *  \return The number of rings.
+     */
+    unsigned getRingCount() const;
+};
+
+#endif // SHAREDRING_H
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file simulation.cpp
+ * \brief File contains the implementation of batch simulations of many games
+ * with a move policy.
+ * 
+ */
+
+#include "simulation.h"
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "batcher.h"
+#include "dataset.h"
+#include "position.h"
+#include "session.h"
+#include "sharedring.h"
+#include <sys/wait.h>
+#include <unistd.h>
+
+simulationConfig::simulationConfig() : boardSize(4), winTile(2048), continueAfterWin(false), nGames(1000),
+    nThreads(1), seed(0), maxMoves(0), checkpointInterval(60000)
+{
+}
+
+/*! \brief Everything a checkpoint needs to continue one worker. */
+struct simulationWorker
+{
+    std::mt19937 mt; /*!< Draws the seed of every game of the worker. */
+    unsigned long nPlayed; /*!< The number of finished games. */
+    std::unique_ptr<session> game; /*!< The game in progress (NULL between two games). */
+    unsigned nMoves; /*!< The number of valid moves of the game in progress. */
+    simulationStatistics stats; /*!< The outcome of the finished games. */
+    std::unique_ptr<datasetWriter> dataset; /*!< Receives the moves of the games (NULL without export). */
+    std::vector<unsigned char> position; /*!< The position before the current move, for the export. */
+};
+
+/*! \brief Coordination between the workers and the thread writing checkpoints. */
+struct checkpointState
+{
+    std::mutex mutex; /*!< Protects the snapshots. */
+    std::condition_variable condition; /*!< Signals a new snapshot. */
+    std::atomic<unsigned> requestedEpoch; /*!< Incremented to ask every worker for a snapshot. */
+    std::vector<unsigned> snapshotEpochs; /*!< The epoch of the latest snapshot of every worker. */
+    std::vector<std::string> snapshots; /*!< The latest snapshot of every worker. */
+};
+
+/*! \brief The snapshot epoch of a worker that finished all its games. */
+static const unsigned finishedEpoch = ~0u;
+
+/*! \brief The magic bytes at the start of a checkpoint file. */
+static const char checkpointMagic[8] = {'G','2','0','4','8','C','P','\0'};
+
+/*! \brief The version of the checkpoint file format. */
+static const uint32_t checkpointVersion = 1;
+
+/*! \brief Get the number of games of a worker.
+ * 
+ *  \param config The simulation parameters.
+ *  \param index The index of the worker.
+ *  \return The number of games.
+ */
+static unsigned long workerGameCount(const simulationConfig& config,const unsigned index)
+{
+    return config.nGames/config.nThreads + (index < config.nGames%config.nThreads ? 1 : 0);
+}
+
+/*! \brief Prepare a worker for its first game.
+ * 
+ *  \param config The simulation parameters.
+ *  \param index The index of the worker.
+ *  \param worker The worker.
+ */
+static void initializeWorker(const simulationConfig& config,const unsigned index,simulationWorker& worker)
+{
+    std::seed_seq seeds = {config.seed,index};
+    worker.mt.seed(seeds);
+    worker.nPlayed = 0;
+    worker.nMoves = 0;
+    if(!config.exportPrefix.empty()) {
+        worker.dataset.reset(new datasetWriter(config.exportPrefix + "-" + std::to_string(index),config.boardSize));
+    }
+}
+
+/*! \brief Write the parts of the configuration a checkpoint depends on.
+ * 
+ *  \param stream The output stream.
+ *  \param config The simulation parameters.
+ */
+static void writeConfig(std::ostream& stream,const simulationConfig& config)
+{
+    writeBinary(stream,(uint32_t)config.boardSize);
+    writeBinary(stream,(uint32_t)config.winTile);
+    writeBinary(stream,(unsigned char)config.continueAfterWin);
+    writeBinary(stream,(uint64_t)config.nGames);
+    writeBinary(stream,(uint32_t)config.nThreads);
+    writeBinary(stream,(uint32_t)config.seed);
+    writeBinary(stream,(uint32_t)config.maxMoves);
+}
+
+/*! \brief Write the state of a worker.
+ * 
+ *  \param stream The output stream.
+ *  \param worker The worker.
+ */
+static void writeWorker(std::ostream& stream,const simulationWorker& worker)
+{
+    writeBinary(stream,(uint64_t)worker.nPlayed);
+    writeGenerator(stream,worker.mt);
+    writeBinary(stream,(unsigned char)(worker.game ? 1 : 0));
+    if(worker.game) {
+        worker.game->write(stream);
+        writeBinary(stream,(uint32_t)worker.nMoves);
+    }
+    worker.stats.write(stream);
+}
+
+/*! \brief Read the state of a worker written by writeWorker().
+ * 
+ *  \param stream The input stream.
+ *  \param config The simulation parameters.
+ *  \param worker Receives the state.
+ *  \return Whether the state was read.
+ */
+static bool readWorker(std::istream& stream,const simulationConfig& config,simulationWorker& worker)
+{
+    uint64_t nPlayed;
+    unsigned char hasGame;
+    if(!readBinary(stream,nPlayed) || !readGenerator(stream,worker.mt) || !readBinary(stream,hasGame)) return false;
+    worker.nPlayed = (unsigned long)nPlayed;
+    worker.game.reset();
+    if(hasGame) {
+        uint32_t nMoves;
+        worker.game.reset(new session(config.boardSize,NULL,0,config.winTile,config.continueAfterWin));
+        if(!worker.game->read(stream) || !readBinary(stream,nMoves)) return false;
+        worker.nMoves = nMoves;
+    }
+    return worker.stats.read(stream);
+}
+
+/*! \brief Write a checkpoint file.
+ * 
+ *  The file is written next to the checkpoint and renamed, so a run killed
+ *  while writing keeps the previous checkpoint.
+ * 
+ *  \param config The simulation parameters.
+ *  \param snapshots The state of every worker written by writeWorker().
+ *  \return Whether the file was written.
+ */
+static bool saveCheckpoint(const simulationConfig& config,const std::vector<std::string>& snapshots)
+{
+    std::string temporaryPath = config.checkpointPath + ".tmp";
+    std::ofstream file(temporaryPath.c_str(),std::ios::binary | std::ios::trunc);
+    file.write(checkpointMagic,sizeof(checkpointMagic));
+    writeBinary(file,checkpointVersion);
+    writeConfig(file,config);
+    for(const std::string& snapshot : snapshots) {
+        writeBinary(file,(uint64_t)snapshot.size());
+        file.write(snapshot.data(),snapshot.size());
+    }
+    file.close();
+    if(!file || std::rename(temporaryPath.c_str(),config.checkpointPath.c_str()) != 0) {
+        std::cerr << "Cannot write the checkpoint " << config.checkpointPath << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*! \brief Continue the workers from a checkpoint file if there is one.
+ * 
+ *  \param config The simulation parameters.
+ *  \param workers The workers, left unchanged if there is no checkpoint file.
+ *  \return Whether there is no checkpoint file or it was read.
+ */
+static bool loadCheckpoint(const simulationConfig& config,std::vector<simulationWorker>& workers)
+{
+    std::ifstream file(config.checkpointPath.c_str(),std::ios::binary);
+    if(!file) return true;
+
+    char magic[sizeof(checkpointMagic)];
+    uint32_t version;
+    std::ostringstream expectedConfig;
+    writeConfig(expectedConfig,config);
+    std::string stored(expectedConfig.str().size(),'\0');
+    if(!file.read(magic,sizeof(magic)) || std::string(magic,sizeof(magic)) != std::string(checkpointMagic,sizeof(checkpointMagic))
+       || !readBinary(file,version) || version != checkpointVersion) {
+        std::cerr << config.checkpointPath << " is not a checkpoint." << std::endl;
+        return false;
+    }
+    if(!file.read(&stored[0],stored.size()) || stored != expectedConfig.str()) {
+        std::cerr << "The checkpoint " << config.checkpointPath << " belongs to a different simulation." << std::endl;
+        return false;
+    }
+    for(unsigned i = 0; i < config.nThreads; ++i) {
+        // A worker record has to end exactly where its size says.
+        uint64_t snapshotSize;
+        std::streampos start;
+        if(!readBinary(file,snapshotSize) || (start = file.tellg()) == std::streampos(-1)
+           || !readWorker(file,config,workers[i]) || uint64_t(file.tellg() - start) != snapshotSize) {
+            std::cerr << "The checkpoint " << config.checkpointPath << " is damaged." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*! \brief Hand a snapshot of a worker to the thread writing checkpoints.
+ * 
+ *  \param checkpoint The checkpoint coordination.
+ *  \param index The index of the worker.
+ *  \param worker The worker.
+ *  \param epoch The epoch of the snapshot.
+ */
+static void publishSnapshot(checkpointState& checkpoint,const unsigned index,const simulationWorker& worker,const unsigned epoch)
+{
+    std::ostringstream snapshot;
+    writeWorker(snapshot,worker);
+    {
+        std::lock_guard<std::mutex> lock(checkpoint.mutex);
+        checkpoint.snapshots[index] = snapshot.str();
+        checkpoint.snapshotEpochs[index] = epoch;
+    }
+    checkpoint.condition.notify_all();
+}
+
+/*! \brief Play one move of the game in progress of a worker.
+ * 
+ *  \param config The simulation parameters.
+ *  \param policy The policy of the worker.
+ *  \param worker The worker, its game must not be NULL.
+ *  \return Whether the game is over.
+ */
+static bool playMove(const simulationConfig& config,movePolicy& policy,simulationWorker& worker)
+{
+    session& game = *worker.game;
+    const board& gameBoard = game.getBoard();
+    char key;
+    bool fromPolicy = false;
+    if(config.maxMoves != 0 && worker.nMoves >= config.maxMoves) key = QUIT;
+    // Every move on a full board loses, the policy would rather quit.
+    else if(countEmptyCells(&gameBoard.getExponents()[0],config.boardSize) == 0) key = UP;
+    else {
+        key = policy(gameBoard);
+        fromPolicy = true;
+    }
+
+    // Only the decisions of the policy are exported.
+    bool exported = worker.dataset && fromPolicy && key != QUIT;
+    if(exported) worker.position = gameBoard.getExponents();
+    unsigned score = game.getScore();
+    // A policy that insists on an invalid move would never finish.
+    if(game.step(key) == INVALID) game.step(QUIT);
+    else {
+        ++worker.nMoves;
+        if(exported) worker.dataset->addMove(worker.position.data(),key,score);
+    }
+
+    if(!game.isFinished()) return false;
+    if(worker.dataset) worker.dataset->endGame(game.getScore());
+    return true;
+}
+
+/*! \brief Play all games of one worker.
+ * 
+ *  \param config The simulation parameters.
+ *  \param index The index of the worker.
+ *  \param worker The state of the worker, continued where it stopped.
+ *  \param checkpoint The checkpoint coordination (NULL without checkpoints).
+ */
+static void simulateWorker(const simulationConfig& config,const unsigned index,simulationWorker& worker,checkpointState* checkpoint)
+{
+    movePolicy policy = config.makePolicy();
+    unsigned long nGames = workerGameCount(config,index);
+    unsigned seenEpoch = 0;
+
+    while(1) {
+        // Snapshot between two moves when the checkpoint writer asks for it.
+        if(checkpoint != NULL && checkpoint->requestedEpoch.load(std::memory_order_relaxed) != seenEpoch) {
+            seenEpoch = checkpoint->requestedEpoch.load(std::memory_order_relaxed);
+            publishSnapshot(*checkpoint,index,worker,seenEpoch);
+        }
+
+        if(!worker.game) {
+            if(worker.nPlayed == nGames) break;
+            worker.game.reset(new session(config.boardSize,NULL,worker.mt(),config.winTile,config.continueAfterWin));
+            worker.nMoves = 0;
+        }
+
+        if(playMove(config,policy,worker)) {
+            session& game = *worker.game;
+            worker.stats.record(game.getMoveState(),game.hasQuit(),game.getScore(),game.getBoard().getMaxTile(),worker.nMoves);
+            worker.game.reset();
+            ++worker.nPlayed;
+        }
+    }
+
+    if(checkpoint != NULL) publishSnapshot(*checkpoint,index,worker,finishedEpoch);
+}
+
+/*! \brief Write checkpoints until all workers finished.
+ * 
+ *  \param config The simulation parameters.
+ *  \param checkpoint The checkpoint coordination.
+ *  \return Whether all checkpoints were written.
+ */
+static bool writeCheckpoints(const simulationConfig& config,checkpointState& checkpoint)
+{
+    auto snapshotsFrom = [&checkpoint](const unsigned epoch) {
+        for(const unsigned snapshotEpoch : checkpoint.snapshotEpochs) {
+            if(snapshotEpoch < epoch) return false;
+        }
+        return true;
+    };
+
+    bool written = true;
+    std::unique_lock<std::mutex> lock(checkpoint.mutex);
+    while(1) {
+        checkpoint.condition.wait_for(lock,config.checkpointInterval,[&]() { return snapshotsFrom(finishedEpoch); });
+        if(!snapshotsFrom(finishedEpoch)) {
+            // Every worker snapshots at its next move, the others keep playing meanwhile.
+            unsigned epoch = checkpoint.requestedEpoch.load() + 1;
+            checkpoint.requestedEpoch.store(epoch);
+            checkpoint.condition.wait(lock,[&]() { return snapshotsFrom(epoch); });
+        }
+
+        bool finished = snapshotsFrom(finishedEpoch);
+        std::vector<std::string> snapshots = checkpoint.snapshots;
+        lock.unlock();
+        written = saveCheckpoint(config,snapshots) && written;
+        lock.lock();
+        if(finished) return written;
+    }
+}
+
+bool runSimulation(const simulationConfig& config,simulationStatistics& stats)
+{
+    assert(config.nThreads > 0);
+    assert(config.makePolicy);
+
+    if(!config.checkpointPath.empty() && !config.exportPrefix.empty()) {
+        std::cerr << "A dataset export can't be resumed from a checkpoint." << std::endl;
+        return false;
+    }
+
+    std::vector<simulationWorker> workers(config.nThreads);
+    for(unsigned i = 0; i < config.nThreads; ++i) initializeWorker(config,i,workers[i]);
+
+    bool written = true;
+    if(config.checkpointPath.empty()) {
+        std::vector<std::thread> threads;
+        for(unsigned i = 1; i < config.nThreads; ++i) {
+            threads.push_back(std::thread(simulateWorker,std::cref(config),i,std::ref(workers[i]),(checkpointState*)NULL));
+        }
+        simulateWorker(config,0,workers[0],NULL);
+        for(std::thread& thread : threads) thread.join();
+    }
+    else {
+        if(!loadCheckpoint(config,workers)) return false;
+
+        checkpointState checkpoint;
+        checkpoint.requestedEpoch = 0;
+        checkpoint.snapshotEpochs.assign(config.nThreads,0);
+        checkpoint.snapshots.resize(config.nThreads);
+        std::vector<std::thread> threads;
+        for(unsigned i = 0; i < config.nThreads; ++i) {
+            threads.push_back(std::thread(simulateWorker,std::cref(config),i,std::ref(workers[i]),&checkpoint));
+        }
+        written = writeCheckpoints(config,checkpoint);
+        for(std::thread& thread : threads) thread.join();
+    }
+
+    stats = simulationStatistics();
+    for(simulationWorker& worker : workers) {
+        stats.merge(worker.stats);
+        if(worker.dataset && !worker.dataset->close()) written = false;
+    }
+    return written;
+}
+
+/*! \brief Play all games of one worker process and publish them into its ring.
+ * 
+ *  \param config The simulation parameters.
+ *  \param index The index of the worker.
+ *  \param rings The rings shared with the collecting process.
+ * 
+ *  Exits the process with EXIT_FAILURE if the dataset export failed.
+ */
+static void simulateProcess(const simulationConfig& config,const unsigned index,sharedRings& rings)
+{
+    simulationWorker worker;
+    initializeWorker(config,index,worker);
+    movePolicy policy = config.makePolicy();
+    unsigned long nGames = workerGameCount(config,index);
+
+    for(; worker.nPlayed < nGames; ++worker.nPlayed) {
+        worker.game.reset(new session(config.boardSize,NULL,worker.mt(),config.winTile,config.continueAfterWin));
+        worker.nMoves = 0;
+        while(!playMove(config,policy,worker)) {}
+
+        const session& game = *worker.game;
+        gameSummary summary;
+        summary.score = game.getScore();
+        summary.maxTile = game.getBoard().getMaxTile();
+        summary.nMoves = worker.nMoves;
+        summary.finalState = game.getMoveState();
+        summary.quit = game.hasQuit();
+        // Wait for the collector while the ring is full.
+        while(!rings.push(index,summary)) std::this_thread::yield();
+    }
+    if(worker.dataset && !worker.dataset->close()) _exit(EXIT_FAILURE);
+}
+
+bool runSimulationProcesses(const simulationConfig& config,simulationStatistics& stats)
+{
+    assert(config.nThreads > 0);
+    assert(config.makePolicy);
+
+    if(!config.checkpointPath.empty()) {
+        std::cerr << "A simulation in worker processes can't be checkpointed." << std::endl;
+        return false;
+    }
+
+    sharedRings rings;
+    if(!rings.create(config.nThreads)) return false;
+
+    bool complete = true;
+    std::vector<pid_t> workers;
+    for(unsigned i = 0; i < config.nThreads; ++i) {
+        pid_t pid = fork();
+        if(pid < 0) {
+            std::cerr << "Cannot start worker process " << i << "." << std::endl;
+            complete = false;
+            break;
+        }
+        if(pid == 0) {
+            simulateProcess(config,i,rings);
+            _exit(EXIT_SUCCESS);
+        }
+        workers.push_back(pid);
+    }
+
+    stats = simulationStatistics();
+    unsigned nRunning = workers.size();
+    gameSummary summary;
+    while(1) {
+        // Reap the workers before draining, so the last drain sees everything they published.
+        for(unsigned i = 0; i < workers.size(); ++i) {
+            int status;
+            if(workers[i] < 0 || waitpid(workers[i],&status,WNOHANG) != workers[i]) continue;
+            if(!WIFEXITED(status)) {
+                std::cerr << "Worker process " << i << " crashed, its remaining games are missing." << std::endl;
+                complete = false;
+            }
+            else if(WEXITSTATUS(status) != EXIT_SUCCESS) complete = false;
+            workers[i] = -1;
+            --nRunning;
+        }
+
+        bool drained = false;
+        for(unsigned i = 0; i < rings.getRingCount(); ++i) {
+            while(rings.pop(i,summary)) {
+                stats.record(gameState_t(summary.finalState),summary.quit != 0,summary.score,summary.maxTile,summary.nMoves);
+                drained = true;
+            }
+        }
+        if(nRunning == 0) return complete;
+        if(!drained) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+movePolicy greedyPolicy(const evaluator& eval)
+{
+    const evaluator* evalPointer = &eval;
+    return [evalPointer](const board& gameBoard) {
+        std::vector<const board*> boards(1,&gameBoard);
+        std::vector<char> moves;
+        chooseMoves(boards,*evalPointer,moves);
+        return moves[0];
+    };
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file simulation.h
+ * \brief File contains the definition of batch simulations of many games with
+ * a move policy.
+ * 
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include "board.h"
+#include "evaluator.h"
+#include "statistics.h"
+
+/*! \brief Chooses the command key for a board (QUIT ends the game). */
+typedef std::function<char(const board&)> movePolicy;
+
+/*! \brief Parameters of a simulation. */
+struct simulationConfig
+{
+    unsigned boardSize; /*!< The number of rows and columns on the board. */
+    unsigned winTile; /*!< The tile value that wins a game. */
+    bool continueAfterWin; /*!< Whether games go on after the win tile has been reached. */
+    unsigned long nGames; /*!< The number of games. */
+    unsigned nThreads; /*!< The number of worker threads. */
+    unsigned seed; /*!< The seed of all random number generators. */
+    unsigned maxMoves; /*!< Games are quit after this many valid moves (0 = no limit). */
+    std::function<movePolicy()> makePolicy; /*!< Called once per worker, the policy is only used by that worker. */
+    std::string checkpointPath; /*!< The checkpoint file (empty = no checkpoints). */
+    std::chrono::milliseconds checkpointInterval; /*!< The time between two checkpoints. */
+    std::string exportPrefix; /*!< Worker w exports its moves to the dataset shards exportPrefix-w (empty = no export). */
+
+    simulationConfig(); /*!< Make the default configuration (1000 games of 4x4 on one thread, no checkpoints or export). */
+};
+
+/*! \brief Play many games and aggregate their outcome.
+ * 
+ *  Worker w plays the games w, w+nThreads, ... with its own random number
+ *  generator, so the result only depends on the configuration. Every worker
+ *  keeps its own statistics which are merged after all workers finished. A game
+ *  is quit when the policy returns QUIT or an invalid move.
+ * 
+ *  With a checkpoint path every worker periodically snapshots its random number
+ *  generator, its game in progress and its statistics between two moves, and
+ *  the snapshots are written to the checkpoint file (replaced atomically). A
+ *  run with the same configuration continues from an existing checkpoint file
+ *  and ends with the same statistics as a run that was never interrupted. The
+ *  last checkpoint holds the finished run, so delete the file to start again.
+ *  Checkpoints can't be combined with a dataset export.
+ * 
+ *  \param config The simulation parameters (makePolicy has to be set).
+ *  \param stats Receives the statistics of all games.
+ *  \return Whether the run finished (false if the checkpoint file does not
+ *          match the configuration or the checkpoint or dataset cannot be written).
+ */
+bool runSimulation(const simulationConfig& config,simulationStatistics& stats);
+
+/*! \brief Play many games in worker processes instead of threads.
+ * 
+ *  The nThreads workers are forked processes that play the same games as the
+ *  threads of runSimulation(), so both give the same statistics. Every worker
+ *  publishes the summary of each finished game into its own lock-free ring in
+ *  shared memory, which the calling process drains and aggregates. A crashing
+ *  worker, e.g. by an experimental policy, only loses its remaining games.
+ *  Datasets are exported like by runSimulation(), but checkpoints are not
+ *  written in this mode and a configuration with a checkpointPath fails.
+ * 
+ *  \param config The simulation parameters (makePolicy is called in the workers).
+ *  \param stats Receives the statistics of all published games.
+ *  \return Whether all workers finished all their games and exported them.
+ */
+bool runSimulationProcesses(const simulationConfig& config,simulationStatistics& stats);
+
+/*! \brief Make a policy that plays the move with the best afterstate.
+ * 
+ *  \param eval The evaluator of the afterstates, has to outlive the policy.
+ *  \return The policy.
+ */
+movePolicy greedyPolicy(const evaluator& eval);
+
+#endif // SIMULATION_H
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file statistics.cpp
+ * \brief File contains the implementation of mergeable streaming statistics of
+ * simulated games.
+ * 
+ */
+
+#include "statistics.h"
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+
+quantileSketch::quantileSketch(const double relativeAccuracy)
+    : gamma((1+relativeAccuracy)/(1-relativeAccuracy)), logGamma(std::log(gamma)), zeroCount(0), total(0), minValue(0), maxValue(0)
+{
+    assert(relativeAccuracy > 0 && relativeAccuracy < 1);
+}
+
+void quantileSketch::add(const double value)
+{
+    assert(value >= 0);
+
+    if(this->total == 0 || value < this->minValue) this->minValue = value;
+    if(this->total == 0 || value > this->maxValue) this->maxValue = value;
+    ++this->total;
+
+    if(value < 1) {
+        ++this->zeroCount;
+        return;
+    }
+    // Bucket k holds the values in (gamma^(k-1),gamma^k].
+    std::size_t bucket = static_cast<std::size_t>(std::ceil(std::log(value)/this->logGamma));
+    if(bucket >= this->counts.size()) this->counts.resize(bucket+1,0);
+    ++this->counts[bucket];
+}
+
+void quantileSketch::merge(const quantileSketch& other)
+{
+    assert(this->gamma == other.gamma);
+
+    if(other.total == 0) return;
+    if(this->total == 0 || other.minValue < this->minValue) this->minValue = other.minValue;
+    if(this->total == 0 || other.maxValue > this->maxValue) this->maxValue = other.maxValue;
+    this->total += other.total;
+    this->zeroCount += other.zeroCount;
+
+    if(other.counts.size() > this->counts.size()) this->counts.resize(other.counts.size(),0);
+    for(std::size_t i = 0; i < other.counts.size(); ++i) this->counts[i] += other.counts[i];
+}
+
+double quantileSketch::quantile(const double q) const
+{
+    assert(q >= 0 && q <= 1);
+
+    if(this->total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q*(this->total-1));
+    // The extremes are known exactly.
+    if(rank == 0) return this->minValue;
+    if(rank == this->total-1) return this->maxValue;
+
+    double value = 0;
+    uint64_t seen = this->zeroCount;
+    if(seen <= rank) {
+        for(std::size_t i = 0; i < this->counts.size(); ++i) {
+            seen += this->counts[i];
+            if(seen > rank) {
+                // The value with the same relative distance to both bounds of the bucket.
+                value = 2*std::pow(this->gamma,double(i))/(this->gamma+1);
+                break;
+            }
+        }
+    }
+    if(value < this->minValue) return this->minValue;
+    if(value > this->maxValue) return this->maxValue;
+    return value;
+}
+
+uint64_t quantileSketch::getCount() const
+{
+    return this->total;
+}
+
+void quantileSketch::write(std::ostream& stream) const
+{
+    writeBinary(stream,this->gamma);
+    writeBinary(stream,this->zeroCount);
+    writeBinary(stream,this->total);
+    writeBinary(stream,this->minValue);
+    writeBinary(stream,this->maxValue);
+    writeBinary(stream,uint64_t(this->counts.size()));
+    for(const uint64_t count : this->counts) writeBinary(stream,count);
+}
+
+bool quantileSketch::read(std::istream& stream)
+{
+    double storedGamma;
+    uint64_t nCounts;
+    if(!readBinary(stream,storedGamma) || storedGamma != this->gamma) return false;
+    if(!readBinary(stream,this->zeroCount) || !readBinary(stream,this->total)) return false;
+    if(!readBinary(stream,this->minValue) || !readBinary(stream,this->maxValue)) return false;
+    // A bucket index beyond 1e5 would be a value far beyond any double.
+    if(!readBinary(stream,nCounts) || nCounts > 100000) return false;
+    this->counts.assign(nCounts,0);
+    for(uint64_t& count : this->counts) {
+        if(!readBinary(stream,count)) return false;
+    }
+    return true;
+}
+
+simulationStatistics::simulationStatistics()
+    : nGames(0), nWins(0), nLosses(0), nQuits(0), scoreSum(0), maxTiles(32,0)
+{
+}
+
+void simulationStatistics::record(const gameState_t finalState,const bool quit,const unsigned score,const unsigned maxTile,const unsigned nMoves)
+{
+    ++this->nGames;
+    if(quit) ++this->nQuits;
+    else if(finalState == WIN) ++this->nWins;
+    else if(finalState == LOOSE) ++this->nLosses;
+
+    this->scoreSum += score;
+    this->scores.add(score);
+    this->lengths.add(nMoves);
+    ++this->maxTiles[maxTile == 0 ? 0 : tileExponent(maxTile)];
+}
+
+void simulationStatistics::merge(const simulationStatistics& other)
+{
+    this->nGames += other.nGames;
+    this->nWins += other.nWins;
+    this->nLosses += other.nLosses;
+    this->nQuits += other.nQuits;
+    this->scoreSum += other.scoreSum;
+    this->scores.merge(other.scores);
+    this->lengths.merge(other.lengths);
+    for(std::size_t i = 0; i < this->maxTiles.size(); ++i) this->maxTiles[i] += other.maxTiles[i];
+}
+
+uint64_t simulationStatistics::getGameCount() const
+{
+    return this->nGames;
+}
+
+uint64_t simulationStatistics::getOutcomeCount(const gameState_t finalState) const
+{
+    if(finalState == WIN) return this->nWins;
+    if(finalState == LOOSE) return this->nLosses;
+    return 0;
+}
+
+uint64_t simulationStatistics::getQuitCount() const
+{
+    return this->nQuits;
+}
+
+double simulationStatistics::getMeanScore() const
+{
+    return this->nGames == 0 ? 0 : this->scoreSum/this->nGames;
+}
+
+const quantileSketch& simulationStatistics::getScores() const
+{
+    return this->scores;
+}
+
+const quantileSketch& simulationStatistics::getLengths() const
+{
+    return this->lengths;
+}
+
+uint64_t simulationStatistics::getMaxTileCount(const unsigned exponent) const
+{
+    return exponent < this->maxTiles.size() ? this->maxTiles[exponent] : 0;
+}
+
+void simulationStatistics::print(std::ostream& stream) const
+{
+    stream << "Games: " << this->nGames << " (won " << this->nWins << ", lost " << this->nLosses
+           << ", quit " << this->nQuits << ")" << std::endl;
+    stream << "Score: mean " << std::fixed << std::setprecision(1) << this->getMeanScore()
+           << std::setprecision(0) << ", median " << this->scores.quantile(0.5)
+           << ", 90% " << this->scores.quantile(0.9) << ", 99% " << this->scores.quantile(0.99) << std::endl;
+    stream << "Moves: median " << this->lengths.quantile(0.5) << ", 90% " << this->lengths.quantile(0.9)
+           << ", max " << this->lengths.quantile(1) << std::endl;
+    stream << "Largest tile:" << std::endl;
+    for(std::size_t i = 0; i < this->maxTiles.size(); ++i) {
+        if(this->maxTiles[i] == 0) continue;
+        stream << std::setw(8) << tileValue(static_cast<unsigned char>(i)) << ": " << this->maxTiles[i] << std::endl;
+    }
+    stream.unsetf(std::ios::fixed);
+    stream << std::setprecision(6);
+}
+
+void simulationStatistics::write(std::ostream& stream) const
+{
+    writeBinary(stream,this->nGames);
+    writeBinary(stream,this->nWins);
+    writeBinary(stream,this->nLosses);
+    writeBinary(stream,this->nQuits);
+    writeBinary(stream,this->scoreSum);
+    this->scores.write(stream);
+    this->lengths.write(stream);
+    for(const uint64_t count : this->maxTiles) writeBinary(stream,count);
+}
+
+bool simulationStatistics::read(std::istream& stream)
+{
+    if(!readBinary(stream,this->nGames) || !readBinary(stream,this->nWins)) return false;
+    if(!readBinary(stream,this->nLosses) || !readBinary(stream,this->nQuits)) return false;
+    if(!readBinary(stream,this->scoreSum)) return false;
+    if(!this->scores.read(stream) || !this->lengths.read(stream)) return false;
+    for(uint64_t& count : this->maxTiles) {
+        if(!readBinary(stream,count)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file statistics.h
+ * \brief File contains the definition of mergeable streaming statistics of
+ * simulated games.
+ * 
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "helper.h"
+
+/*! \brief Mergeable sketch of a distribution of non-negative values.
+ *
+ *  Values are counted in logarithmic buckets, so every quantile is returned
+ *  with a bounded relative error and the memory only grows with the logarithm
+ *  of the largest value. Two sketches with the same accuracy are merged by
+ *  adding their bucket counts.
+ */
+class quantileSketch
+{
+private:
+    double gamma; /*!< The ratio between the bounds of a bucket. */
+    double logGamma; /*!< The natural logarithm of gamma. */
+    std::vector<uint64_t> counts; /*!< The count of bucket k (values in (gamma^(k-1),gamma^k]). */
+    uint64_t zeroCount; /*!< The count of values below 1. */
+    uint64_t total; /*!< The number of values. */
+    double minValue; /*!< The smallest value. */
+    double maxValue; /*!< The largest value. */
+
+public:
+    /*! \brief Make a new, empty sketch.
+     * 
+     *  \param relativeAccuracy The largest relative error of a quantile.
+     */
+    quantileSketch(const double relativeAccuracy = 0.01);
+
+    /*! \brief Add a value.
+     * 
+     *  \param value The value (>= 0, values below 1 are counted as 0).
+     */
+    void add(const double value);
+
+    /*! \brief Add all values of another sketch.
+     * 
+     *  \param other A sketch with the same accuracy.
+     */
+    void merge(const quantileSketch& other);
+
+    /*! \brief Get a quantile.
+     * 
+     *  \param q The quantile, between 0 and 1.
+     *  \return The approximate value of the quantile (0 for an empty sketch).
+     */
+    double quantile(const double q) const;
+
+    /*! \brief Get the number of values.
+     * 
+     *  \return The number of values.
+     */
+    uint64_t getCount() const;
+
+    /*! \brief Write the sketch in a compact binary form.
+     * 
+     *  \param stream The output stream.
+     */
+    void write(std::ostream& stream) const;
+
+    /*! \brief Read a sketch written by write().
+     * 
+     *  \param stream The input stream.
+     *  \return Whether a sketch with the same accuracy was read.
+     */
+    bool read(std::istream& stream);
+};
+
+/*! \brief Aggregated outcome of many games.
+ *
+ *  Every worker thread fills its own instance without locking, the instances
+ *  are merged afterwards.
+ */
+class simulationStatistics
+{
+private:
+    uint64_t nGames; /*!< The number of games. */
+    uint64_t nWins; /*!< Games that ended with WIN. */
+    uint64_t nLosses; /*!< Games that ended with LOOSE. */
+    uint64_t nQuits; /*!< Games that were quit. */
+    double scoreSum; /*!< The sum of all scores. */
+    quantileSketch scores; /*!< The distribution of the scores. */
+    quantileSketch lengths; /*!< The distribution of the number of moves per game. */
+    std::vector<uint64_t> maxTiles; /*!< The number of games per exponent of the largest tile. */
+
+public:
+    simulationStatistics(); /*!< Make empty statistics. */
+
+    /*! \brief Add a finished game.
+     * 
+     *  \param finalState The state after the last valid move (WIN, LOOSE or UNFINISHED).
+     *  \param quit Whether the game was quit.
+     *  \param score The final score.
+     *  \param maxTile The largest tile value.
+     *  \param nMoves The number of valid moves.
+     */
+    void record(const gameState_t finalState,const bool quit,const unsigned score,const unsigned maxTile,const unsigned nMoves);
+
+    /*! \brief Add all games of other statistics.
+     * 
+     *  \param other The other statistics.
+     */
+    void merge(const simulationStatistics& other);
+
+    /*! \brief Get the number of games.
+     * 
+     *  \return The number of games.
+     */
+    uint64_t getGameCount() const;
+
+    /*! \brief Get the number of games with a final state.
+     * 
+     *  \param finalState WIN or LOOSE.
+     *  \return The number of games.
+     */
+    uint64_t getOutcomeCount(const gameState_t finalState) const;
+
+    /*! \brief Get the number of games that were quit.
+     * 
+     *  \return The number of games.
+     */
+    uint64_t getQuitCount() const;
+
+    /*! \brief Get the mean score.
+     * 
+     *  \return The mean score (0 without games).
+     */
+    double getMeanScore() const;
+
+    /*! \brief Get the distribution of the scores.
+     * 
+     *  \return The score sketch.
+     */
+    const quantileSketch& getScores() const;
+
+    /*! \brief Get the distribution of the game lengths.
+     * 
+     *  \return The game length sketch.
+     */
+    const quantileSketch& getLengths() const;
+
+    /*! \brief Get the number of games whose largest tile is 2^exponent.
+     * 
+     *  \param exponent The exponent of the largest tile.
+     *  \return The number of games.
+     */
+    uint64_t getMaxTileCount(const unsigned exponent) const;
+
+    /*! \brief Print a summary.
+     * 
+     *  \param stream The output stream.
+     */
+    void print(std::ostream& stream) const;
+
+    /*! \brief Write the statistics in a compact binary form.
+     * 
+     *  \param stream The output stream.
+     */
+    void write(std::ostream& stream) const;
+
+    /*! \brief Read statistics written by write().
+     * 
+     *  \param stream The input stream.
+     *  \return Whether the statistics were read.
+     */
+    bool read(std::istream& stream);
+};
+
+#endif // STATISTICS_H
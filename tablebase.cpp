@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file tablebase.cpp
+ * \brief File contains the implementation of the endgame tablebase.
+ * 
+ */
+
+#include "tablebase.h"
+#include "position.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*! \brief Header of a tablebase file.
+ *
+ */
+struct tablebaseHeader
+{
+    char magic[8]; /*!< "G2048TB" and a terminating zero. */
+    uint32_t version; /*!< The file format version. */
+    uint32_t size; /*!< The number of rows and columns. */
+    uint32_t targetExponent; /*!< The exponent of the win tile. */
+    uint32_t valueBits; /*!< The number of bits of a stored value. */
+    uint64_t nStates; /*!< The number of stored values. */
+};
+
+static const char tablebaseMagic[8] = "G2048TB";
+
+// Whether generate() accepts a configuration: the cell buffers hold up to 6x6
+// boards, moves need tiles up to at least 4 and indices have to fit 32 bits.
+static bool isValidConfiguration(const unsigned size,const unsigned targetExponent)
+{
+    if(size < 2 || size > 6 || targetExponent < 3) return false;
+    uint64_t count = 1;
+    for(unsigned i = 0; i < size*size; ++i) {
+        count *= targetExponent;
+        if(count > 0xffffffffULL) return false;
+    }
+    return true;
+}
+
+// The contribution of a tile to the tile sum of a layer, in units of 2.
+static unsigned layerWeight(const unsigned exponent)
+{
+    return exponent == 0 ? 0 : 1u << (exponent - 1);
+}
+
+tablebase::tablebase() : size(0), targetExponent(0), nStates(0), values(NULL), mapping(NULL), mappingSize(0)
+{
+}
+
+tablebase::~tablebase()
+{
+    this->release();
+}
+
+void tablebase::release()
+{
+    if(this->mapping) munmap(this->mapping,this->mappingSize);
+    this->mapping = NULL;
+    this->mappingSize = 0;
+    this->ownedValues.clear();
+    this->values = NULL;
+    this->size = 0;
+    this->targetExponent = 0;
+    this->nStates = 0;
+}
+
+uint64_t tablebase::stateCount(const unsigned size,const unsigned targetExponent)
+{
+    uint64_t count = 1;
+    for(unsigned i = 0; i < size*size; ++i) {
+        // Saturate instead of overflowing for configurations that are far too large.
+        if(count > (uint64_t(1) << 56)) return uint64_t(-1);
+        count *= targetExponent;
+    }
+    return count;
+}
+
+uint64_t tablebase::index(const unsigned char* cells) const
+{
+    uint64_t result = 0;
+    for(unsigned i = this->size*this->size; i > 0; --i) result = result*this->targetExponent + cells[i-1];
+    return result;
+}
+
+template<class valueFunction> char tablebase::solve(const unsigned char* cells,const valueFunction& stateValue,double& value) const
+{
+    const char directions[4] = {UP,DOWN,LEFT,RIGHT};
+    const unsigned nCells = this->size*this->size;
+    const bool isFull = countEmptyCells(cells,this->size) == 0;
+    unsigned char result[36];
+
+    char move = QUIT;
+    value = 0.0;
+    for(const char direction : directions) {
+        unsigned reward = 0;
+        if(!movePosition(cells,result,this->size,direction,reward)) continue;
+
+        double moveValue = 0.0;
+        if(isFull) {
+            // board::move() loses on a full board, whatever the direction.
+        }
+        else if(*std::max_element(result,result+nCells) >= this->targetExponent) {
+            moveValue = 1.0;
+        }
+        else {
+            // Average over all spawns, the children have a larger tile sum.
+            uint64_t base = this->index(result);
+            uint64_t digit = 1;
+            unsigned nEmpty = 0;
+            for(unsigned i = 0; i < nCells; ++i, digit *= this->targetExponent) {
+                if(result[i] != 0) continue;
+                ++nEmpty;
+                moveValue += 0.9*stateValue(base + digit) + 0.1*stateValue(base + 2*digit);
+            }
+            moveValue /= nEmpty;
+        }
+        if(move == QUIT || moveValue > value) {
+            move = direction;
+            value = moveValue;
+        }
+    }
+    return move;
+}
+
+bool tablebase::generate(const unsigned size,const unsigned targetExponent,threadPool& pool,const uint64_t maxStates)
+{
+    uint64_t count = stateCount(size,targetExponent);
+    if(!isValidConfiguration(size,targetExponent) || count > maxStates) {
+        std::cerr << "Tablebase " << size << "x" << size << " up to " << tileValue(targetExponent)
+                  << " is too large (" << count << " positions)." << std::endl;
+        return false;
+    }
+    this->release();
+    this->size = size;
+    this->targetExponent = targetExponent;
+    this->nStates = count;
+    const unsigned nCells = size*size;
+
+    // Sort all positions by tile sum (a counting sort, in units of 2), counting
+    // through the indices like an odometer.
+    const unsigned maxLayer = nCells*layerWeight(targetExponent - 1);
+    std::vector<uint32_t> layerStart(maxLayer + 2,0);
+    std::vector<uint32_t> order(count);
+    for(unsigned pass = 0; pass < 2; ++pass) {
+        unsigned char cells[36] = {0};
+        unsigned layer = 0;
+        for(uint64_t i = 0; i < count; ++i) {
+            if(pass == 0) ++layerStart[layer + 1]; else order[layerStart[layer]++] = uint32_t(i);
+            for(unsigned k = 0; k < nCells; ++k) {
+                layer -= layerWeight(cells[k]);
+                if(++cells[k] < targetExponent) {
+                    layer += layerWeight(cells[k]);
+                    break;
+                }
+                cells[k] = 0;
+            }
+        }
+        if(pass == 0) {
+            for(unsigned l = 1; l < layerStart.size(); ++l) layerStart[l] += layerStart[l-1];
+        }
+        else {
+            // Filling has moved every start to the start of the next layer.
+            for(unsigned l = layerStart.size() - 1; l > 0; --l) layerStart[l] = layerStart[l-1];
+            layerStart[0] = 0;
+        }
+    }
+
+    // Solve the layers from the largest tile sum down, every layer in parallel chunks.
+    std::vector<float> work(count);
+    const uint32_t chunkSize = 4096;
+    for(unsigned layer = maxLayer + 1; layer > 0; --layer) {
+        uint32_t first = layerStart[layer - 1];
+        uint32_t last = layerStart[layer];
+        taskGroup group(pool);
+        for(uint32_t chunk = first; chunk < last; chunk += chunkSize) {
+            uint32_t chunkEnd = std::min(last,chunk + chunkSize);
+            group.run([this,&order,&work,chunk,chunkEnd,nCells]() {
+                unsigned char cells[36];
+                for(uint32_t k = chunk; k < chunkEnd; ++k) {
+                    uint64_t remainder = order[k];
+                    for(unsigned i = 0; i < nCells; ++i) {
+                        cells[i] = remainder % this->targetExponent;
+                        remainder /= this->targetExponent;
+                    }
+                    double value;
+                    this->solve(cells,[&work](const uint64_t i) { return double(work[i]); },value);
+                    work[order[k]] = float(value);
+                }
+            });
+        }
+        group.wait();
+    }
+
+    // Store the values as 16 bit fixed point numbers.
+    this->ownedValues.resize(count);
+    for(uint64_t i = 0; i < count; ++i) this->ownedValues[i] = uint16_t(std::lround(work[i]*65535.0));
+    this->values = this->ownedValues.data();
+    return true;
+}
+
+bool tablebase::save(const std::string& path) const
+{
+    assert(this->values != NULL);
+
+    tablebaseHeader header;
+    std::memset(&header,0,sizeof(header));
+    std::memcpy(header.magic,tablebaseMagic,sizeof(header.magic));
+    header.version = 1;
+    header.size = this->size;
+    header.targetExponent = this->targetExponent;
+    header.valueBits = 16;
+    header.nStates = this->nStates;
+
+    std::ofstream file(path.c_str(),std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    file.write(reinterpret_cast<const char*>(this->values),this->nStates*sizeof(uint16_t));
+    return bool(file);
+}
+
+bool tablebase::load(const std::string& path)
+{
+    this->release();
+
+    int fd = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    struct stat status;
+    if(fstat(fd,&status) < 0 || std::size_t(status.st_size) < sizeof(tablebaseHeader)) {
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL,status.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if(mapping == MAP_FAILED) return false;
+
+    // Check the header before using the values, a corrupt size would overflow the cell buffers.
+    const tablebaseHeader* header = static_cast<const tablebaseHeader*>(mapping);
+    if(std::memcmp(header->magic,tablebaseMagic,sizeof(header->magic)) != 0 || header->version != 1 || header->valueBits != 16
+       || !isValidConfiguration(header->size,header->targetExponent)
+       || header->nStates != stateCount(header->size,header->targetExponent)
+       || std::size_t(status.st_size) != sizeof(tablebaseHeader) + header->nStates*sizeof(uint16_t)) {
+        munmap(mapping,status.st_size);
+        return false;
+    }
+    this->mapping = mapping;
+    this->mappingSize = status.st_size;
+    this->size = header->size;
+    this->targetExponent = header->targetExponent;
+    this->nStates = header->nStates;
+    this->values = reinterpret_cast<const uint16_t*>(static_cast<const char*>(mapping) + sizeof(tablebaseHeader));
+    return true;
+}
+
+bool tablebase::covers(const unsigned char* cells,const unsigned size) const
+{
+    if(this->values == NULL || size != this->size) return false;
+    for(unsigned i = 0; i < size*size; ++i) if(cells[i] >= this->targetExponent) return false;
+    return true;
+}
+
+double tablebase::probe(const unsigned char* cells) const
+{
+    assert(this->covers(cells,this->size));
+    return this->values[this->index(cells)]/65535.0;
+}
+
+char tablebase::bestMove(const unsigned char* cells,double& value) const
+{
+    assert(this->covers(cells,this->size));
+    return this->solve(cells,[this](const uint64_t i) { return this->values[i]/65535.0; },value);
+}
+
+unsigned tablebase::getSize() const
+{
+    return this->size;
+}
+
+unsigned tablebase::getTargetExponent() const
+{
+    return this->targetExponent;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file tablebase.h
+ * \brief File contains the definition of the endgame tablebase that stores the
+ * exact win probability of every position of a small board.
+ * 
+ */
+
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "board.h"
+#include "threadpool.h"
+
+/*! \brief Exact win probabilities of all positions of a small board.
+ *
+ *  A tablebase covers one board size and one win tile 2^targetExponent. It
+ *  stores, for every position whose tiles are all below the win tile, the
+ *  probability of reaching the win tile under optimal play with the rules of
+ *  board::move(): a full board loses, and spawns are a 2 (90 %) or a 4 (10 %)
+ *  in any empty cell.
+ *
+ *  Every move plus spawn increases the sum of all tiles, so the values are
+ *  generated by retrograde analysis from the largest tile sum down. Positions
+ *  with the same sum only depend on larger sums and are computed in parallel.
+ *  The index of a position is its exponents as base-targetExponent digits in
+ *  row-major order. Values are stored as 16 bit fixed point numbers.
+ *
+ *  The file format is a fixed header followed by the values in index order,
+ *  which is memory-mapped by load(). The values are not compressed: a probe
+ *  reads one value of the mapping directly, while a compressed table would
+ *  have to decode a block per probe. The 16 bit values take half the space of
+ *  floats, a 3x3 table up to 256 (8^9 positions) takes 256 MiB.
+ */
+class tablebase
+{
+private:
+    unsigned size; /*!< The number of rows and columns. */
+    unsigned targetExponent; /*!< The exponent of the win tile. */
+    uint64_t nStates; /*!< The number of stored positions. */
+    std::vector<uint16_t> ownedValues; /*!< The values, if generated in memory. */
+    const uint16_t* values; /*!< The values, generated or memory-mapped. */
+    void* mapping; /*!< The memory-mapped file (NULL if generated). */
+    std::size_t mappingSize; /*!< The size of the mapping in bytes. */
+
+    /*! \brief Release the values. */
+    void release();
+
+    /*! \brief Compute the index of a position.
+     * 
+     *  \param cells The cell exponents, all below targetExponent.
+     *  \return The index.
+     */
+    uint64_t index(const unsigned char* cells) const;
+
+    /*! \brief Compute the best move from a position.
+     * 
+     *  \param cells The cell exponents, all below targetExponent.
+     *  \param stateValue The value of a position, given its index.
+     *  \param value The win probability of the best move.
+     *  \return The best move (QUIT if there is none).
+     */
+    template<class valueFunction> char solve(const unsigned char* cells,const valueFunction& stateValue,double& value) const;
+
+public:
+    tablebase(); /*!< Make an empty tablebase. */
+
+    ~tablebase(); /*!< Destructor that releases the values. */
+
+    /*! \brief Get the number of positions of a configuration.
+     * 
+     *  \param size The number of rows and columns.
+     *  \param targetExponent The exponent of the win tile.
+     *  \return The number of positions.
+     */
+    static uint64_t stateCount(const unsigned size,const unsigned targetExponent);
+
+    /*! \brief Generate all values by retrograde analysis.
+     * 
+     *  \param size The number of rows and columns.
+     *  \param targetExponent The exponent of the win tile (at least 3).
+     *  \param pool Runs the positions of every tile sum in parallel.
+     *  \param maxStates The largest number of positions that may be generated.
+     *  \return Whether the configuration was small enough to be generated.
+     */
+    bool generate(const unsigned size,const unsigned targetExponent,threadPool& pool,const uint64_t maxStates = 1 << 25);
+
+    /*! \brief Write the tablebase to a file.
+     * 
+     *  \param path The file path.
+     *  \return Whether the file was written.
+     */
+    bool save(const std::string& path) const;
+
+    /*! \brief Memory-map a tablebase file.
+     * 
+     *  \param path The file path.
+     *  \return Whether the file is a valid tablebase.
+     */
+    bool load(const std::string& path);
+
+    /*! \brief Check whether a position is in the tablebase.
+     * 
+     *  \param cells The cell exponents.
+     *  \param size The number of rows and columns.
+     *  \return Whether the size matches and all tiles are below the win tile.
+     */
+    bool covers(const unsigned char* cells,const unsigned size) const;
+
+    /*! \brief Get the win probability of a position in the tablebase.
+     * 
+     *  \param cells The cell exponents of a covered position.
+     *  \return The win probability with the player to move.
+     */
+    double probe(const unsigned char* cells) const;
+
+    /*! \brief Get the best move of a position in the tablebase.
+     * 
+     *  \param cells The cell exponents of a covered position.
+     *  \param value The win probability after the best move.
+     *  \return The best move (QUIT if there is none).
+     */
+    char bestMove(const unsigned char* cells,double& value) const;
+
+    /*! \brief Get the number of rows and columns.
+     * 
+     *  \return The board size (0 if empty).
+     */
+    unsigned getSize() const;
+
+    /*! \brief Get the exponent of the win tile.
+     * 
+     *  \return The exponent of the win tile.
+     */
+    unsigned getTargetExponent() const;
+};
+
+#endif // TABLEBASE_H
@@ -27,8 +27,43 @@
  */
 
 #include "board.h"
+#include "server.h"
+#include "session.h"
+#include "evaluator.h"
+#include "batcher.h"
+#include "arena.h"
+#include "position.h"
+#include "search.h"
+#include "threadpool.h"
+#include "cache.h"
+#include "packed.h"
+#include "fuzz.h"
+#include "tablebase.h"
+#include "statistics.h"
+#include "simulation.h"
+#include "sharedring.h"
+#include "dataset.h"
+#include "ponder.h"
+#include "keyboard.h"
+#include "history.h"
+#include <map>
+#include <thread>
+#include <fcntl.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <csignal>
 #include <gtest/gtest.h>
 
+// Path of a temporary file of this test process.
+static std::string temporaryPath(const std::string& suffix)
+{
+    return "/tmp/game2048-test-" + std::to_string(getpid()) + suffix;
+}
+
 TEST(boardTest, checkAddRandomValue)
 {
     // Initialize random number generator.
@@ -263,3 +298,1334 @@ TEST(boardTest, checkMoveWith2Merges) {
     EXPECT_EQ(gameState,UNFINISHED);
     EXPECT_EQ(myBoard.getBoardValues(),boardValAfter);
 }
+
+// Check that cells are stored as exponents and converted back to tile values.
+TEST(boardTest, checkExponentStorage) {
+    board myBoard(4);
+    std::vector< std::vector<unsigned> > boardValues;
+
+    boardValues = {{0,2,4,8},{16,32,64,128},{256,512,1024,0},{0,0,0,0}};
+    myBoard.setBoardValues(boardValues);
+    EXPECT_EQ(myBoard.getBoardValues(),boardValues);
+    EXPECT_EQ(myBoard(0,1),1);
+    EXPECT_EQ(myBoard(2,2),10);
+    EXPECT_EQ(myBoard.getExponents().size(),16);
+    EXPECT_EQ(myBoard.getMaxTile(),1024);
+    EXPECT_EQ(tileValue(0),0);
+    EXPECT_EQ(tileValue(16),65536);
+    EXPECT_EQ(tileExponent(65536),16);
+}
+
+// Check the win tile with and without "continue after win" mode.
+TEST(boardTest, checkWin) {
+    unsigned score;
+    std::vector< std::vector<unsigned> > boardValBefore {{1024,1024,0,0},{0,0,0,0},{0,0,0,0},{0,0,0,0}};
+
+    // Default: 2048 wins and the move is completed.
+    board myBoard(4);
+    myBoard.setBoardValues(boardValBefore);
+    score = 0;
+    EXPECT_EQ(myBoard.move(UP,score),WIN);
+    EXPECT_EQ(score,2048);
+    EXPECT_EQ(myBoard(0,0),11);
+    EXPECT_EQ(myBoard(0,1),0);
+    EXPECT_EQ(myBoard.move(LEFT,score),WIN);
+
+    // Configurable win tile.
+    board smallWinBoard(4,8);
+    smallWinBoard.setBoardValues({{4,4,0,0},{0,0,0,0},{0,0,0,0},{0,0,0,0}});
+    score = 0;
+    EXPECT_EQ(smallWinBoard.move(UP,score),WIN);
+    EXPECT_EQ(smallWinBoard.getWinTile(),8);
+
+    // Continue after win: WIN is reported once, then play goes on.
+    board continueBoard(4,2048,true);
+    continueBoard.setBoardValues(boardValBefore);
+    score = 0;
+    EXPECT_EQ(continueBoard.move(UP,score),WIN);
+    EXPECT_EQ(continueBoard.hasWon(),true);
+    EXPECT_EQ(continueBoard.move(DOWN,score),UNFINISHED);
+}
+
+// Check that play continues beyond 32768.
+TEST(boardTest, checkMovePast2048) {
+    board myBoard(4,2048,true);
+    unsigned score = 0;
+    std::vector< std::vector<unsigned> > boardValAfter {{65536,0,0,0},{0,0,0,0},{0,0,0,0},{0,0,0,0}};
+
+    myBoard.setBoardValues({{32768,32768,0,0},{0,0,0,0},{0,0,0,0},{0,0,0,0}});
+    EXPECT_EQ(myBoard.move(UP,score),WIN);
+    EXPECT_EQ(score,65536);
+    EXPECT_EQ(myBoard.getBoardValues(),boardValAfter);
+    EXPECT_EQ(myBoard.getMaxTile(),65536);
+}
+
+// Check the encoding of server replies.
+TEST(serverTest, checkReplyEncoding) {
+    std::vector<unsigned char> before {0,1,1,0};
+    std::vector<unsigned char> after {2,0,1,1};
+    std::string reply;
+
+    appendServerReply(before,after,UNFINISHED,260,reply);
+    std::string expected {char(UNFINISHED),0,0,1,4,3,0,2,1,0,3,1};
+    EXPECT_EQ(reply,expected);
+}
+
+// Check a complete session against a running server.
+TEST(serverTest, checkSession) {
+    std::string socketPath = temporaryPath(".sock");
+    server gameServer(socketPath);
+    ASSERT_TRUE(gameServer.start());
+    std::thread serverThread([&gameServer]() { gameServer.run(); });
+
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    struct sockaddr_un address;
+    std::memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path,socketPath.c_str(),sizeof(address.sun_path)-1);
+    ASSERT_EQ(connect(fd,(struct sockaddr*)&address,sizeof(address)),0);
+
+    // Read one reply and apply its changes to a local copy of the board.
+    std::vector<unsigned char> cells(9,0);
+    auto readReply = [fd,&cells](unsigned char& state) {
+        unsigned char header[6];
+        EXPECT_EQ(recv(fd,header,6,MSG_WAITALL),6);
+        state = header[0];
+        std::vector<unsigned char> changes(2*header[5]);
+        if(!changes.empty()) {
+            EXPECT_EQ(recv(fd,changes.data(),changes.size(),MSG_WAITALL),ssize_t(changes.size()));
+        }
+        for(unsigned i = 0; i < changes.size(); i += 2) cells.at(changes[i]) = changes[i+1];
+        return (unsigned(header[1]) << 24) | (unsigned(header[2]) << 16) | (unsigned(header[3]) << 8) | header[4];
+    };
+
+    // A new 3x3 game starts with one tile.
+    unsigned char state;
+    const char newGame[2] = {SERVER_NEW,3};
+    ASSERT_EQ(send(fd,newGame,2,0),2);
+    EXPECT_EQ(readReply(state),0);
+    EXPECT_EQ(state,UNFINISHED);
+    EXPECT_EQ(std::count(cells.begin(),cells.end(),0),8);
+
+    // Every move is answered, valid moves add a tile.
+    const char moves[8] = {SERVER_MOVE,UP,SERVER_MOVE,LEFT,SERVER_MOVE,DOWN,SERVER_MOVE,RIGHT};
+    ASSERT_EQ(send(fd,moves,8,0),8);
+    for(unsigned i = 0; i < 4; ++i) readReply(state);
+    EXPECT_LT(std::count(cells.begin(),cells.end(),0),8);
+    EXPECT_EQ(gameServer.getSessionCount(),1);
+
+    // QUIT closes the connection.
+    const char quit[2] = {SERVER_QUIT,0};
+    ASSERT_EQ(send(fd,quit,2,0),2);
+    char buffer;
+    EXPECT_EQ(recv(fd,&buffer,1,0),0);
+    close(fd);
+
+    gameServer.stop();
+    serverThread.join();
+    EXPECT_EQ(gameServer.getSessionCount(),0);
+}
+
+// Check that a client that does not read its replies cannot make the server buffer without bound.
+TEST(serverTest, checkOutputLimit) {
+    std::string socketPath = temporaryPath("-limit.sock");
+    server gameServer(socketPath);
+    ASSERT_TRUE(gameServer.start());
+    std::thread serverThread([&gameServer]() { gameServer.run(); });
+
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    struct sockaddr_un address;
+    std::memset(&address,0,sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path,socketPath.c_str(),sizeof(address.sun_path)-1);
+    ASSERT_EQ(connect(fd,(struct sockaddr*)&address,sizeof(address)),0);
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+
+    // Send moves of a 4x4 game until the server stops taking them for 200 ms.
+    std::string requests;
+    requests.push_back(SERVER_NEW);
+    requests.push_back(4);
+    for(unsigned i = 0; i < 1 << 20; ++i) {
+        requests.push_back(SERVER_MOVE);
+        requests.push_back("wasd"[i % 4]);
+    }
+    std::size_t nSent = 0;
+    std::chrono::steady_clock::time_point lastProgress = std::chrono::steady_clock::now();
+    while(nSent < requests.size() && std::chrono::steady_clock::now() - lastProgress < std::chrono::milliseconds(200)) {
+        ssize_t n = send(fd,requests.data()+nSent,std::min<std::size_t>(4096,requests.size()-nSent),MSG_NOSIGNAL);
+        if(n > 0) {
+            nSent += n;
+            lastProgress = std::chrono::steady_clock::now();
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    EXPECT_LT(nSent,requests.size());
+
+    // Reading the replies lets the server continue with the held back requests.
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) & ~O_NONBLOCK);
+    std::size_t nReplies = 0;
+    std::size_t nRequests = nSent/2;
+    while(nReplies < nRequests) {
+        unsigned char header[6];
+        ASSERT_EQ(recv(fd,header,6,MSG_WAITALL),6);
+        std::vector<unsigned char> changes(2*header[5]);
+        if(!changes.empty()) {
+            ASSERT_EQ(recv(fd,changes.data(),changes.size(),MSG_WAITALL),ssize_t(changes.size()));
+        }
+        ++nReplies;
+    }
+    EXPECT_EQ(gameServer.getSessionCount(),1);
+    close(fd);
+
+    gameServer.stop();
+    serverThread.join();
+}
+
+// Check that a replayed session plays the same game as a manually stepped one.
+TEST(sessionTest, checkReplay) {
+    std::string keys = "wasdwasdxxwwaassdd";
+    std::istringstream stream(keys);
+    replayInput replay(stream);
+
+    session replayed(4,&replay,42);
+    session stepped(4,NULL,42);
+    EXPECT_EQ(replayed.resume(),true);
+    for(const char key : keys) if(key != 'x') stepped.step(key);
+
+    EXPECT_EQ(replayed.hasQuit(),true);
+    EXPECT_EQ(replayed.getScore(),stepped.getScore());
+    EXPECT_EQ(replayed.getBoard().getExponents(),stepped.getBoard().getExponents());
+}
+
+// Check that a session suspends without input and resumes where it stopped.
+TEST(sessionTest, checkSuspend) {
+    queueInput queue;
+    session game(4,&queue,7);
+    unsigned nMoves = 0;
+    game.setObserver([&nMoves](const session& currentGame,const gameState_t moveState) { ++nMoves; });
+
+    EXPECT_EQ(game.resume(),false);
+    queue.push(UP);
+    queue.push(LEFT);
+    queue.push(DOWN);
+    EXPECT_EQ(game.resume(),false);
+    EXPECT_GE(nMoves,1);
+    queue.push(QUIT);
+    EXPECT_EQ(game.resume(),true);
+    EXPECT_EQ(game.hasQuit(),true);
+}
+
+// Check many sessions interleaved on a few threads.
+TEST(sessionTest, checkPool) {
+    const unsigned nSessions = 64;
+    const char cycle[4] = {UP,LEFT,DOWN,RIGHT};
+    policyInput cyclePolicy([&cycle](const board& gameBoard) {
+        static thread_local unsigned i = 0;
+        return cycle[i++ % 4];
+    });
+    std::vector<queueInput> queues(nSessions);
+    std::vector<session> games;
+    for(unsigned i = 0; i < nSessions; ++i) {
+        if(i % 2 == 0) games.push_back(session(4,&cyclePolicy,i));
+        else games.push_back(session(3,&queues.at(i),i));
+    }
+
+    sessionPool pool(4);
+    for(session& game : games) pool.add(game);
+
+    // Feed the queue-driven sessions from this thread while the pool runs.
+    for(unsigned round = 0; round < 50; ++round) {
+        for(unsigned i = 1; i < nSessions; i += 2) {
+            queues.at(i).push(cycle[round % 4]);
+            pool.wake(games.at(i));
+        }
+    }
+    for(unsigned i = 1; i < nSessions; i += 2) {
+        queues.at(i).push(QUIT);
+        pool.wake(games.at(i));
+    }
+    pool.waitAll();
+
+    for(unsigned i = 0; i < nSessions; ++i) {
+        EXPECT_EQ(games.at(i).isFinished(),true);
+        if(i % 2 == 0) {
+            EXPECT_EQ(games.at(i).getMoveState(),LOOSE);
+        }
+    }
+}
+
+// Check that waking a finished session does not count it as finished twice.
+TEST(sessionTest, checkWakeFinished) {
+    queueInput input;
+    session game(3,&input,1);
+    sessionPool pool(2);
+    pool.add(game);
+    input.push(QUIT);
+    pool.wake(game);
+    pool.waitAll();
+    EXPECT_TRUE(game.isFinished());
+
+    // A stale wake after the end must not reach the worker, or waitAll() below never returns.
+    for(unsigned i = 0; i < 10; ++i) pool.wake(game);
+    queueInput otherInput;
+    session other(3,&otherInput,2);
+    otherInput.push(QUIT);
+    pool.add(other);
+    pool.waitAll();
+    EXPECT_TRUE(other.isFinished());
+}
+
+// Check that batched evaluation gives the same values as single evaluations.
+TEST(evaluatorTest, checkBatch) {
+    std::mt19937 mt(1);
+    positionBatch batch(4);
+    heuristicEvaluator heuristic;
+    ntupleEvaluator ntuple(ntupleEvaluator::lineTuples(4));
+    for(unsigned t = 0; t < 8; ++t) {
+        for(float& weight : ntuple.getWeights(t)) weight = float(mt() % 1000);
+    }
+
+    board myBoard(4);
+    for(unsigned i = 0; i < 100; ++i) {
+        myBoard.addRandomValue(mt);
+        unsigned score = 0;
+        if(myBoard.move("wasd"[mt() % 4],score) == LOOSE) myBoard.zero();
+        batch.add(myBoard.getExponents());
+    }
+    EXPECT_EQ(batch.getCount(),100);
+
+    std::vector<double> values;
+    heuristic.evaluateBatch(batch,values);
+    for(unsigned i = 0; i < batch.getCount(); ++i) EXPECT_EQ(values.at(i),heuristic.evaluate(batch.getPosition(i),4));
+    ntuple.evaluateBatch(batch,values);
+    for(unsigned i = 0; i < batch.getCount(); ++i) EXPECT_EQ(values.at(i),ntuple.evaluate(batch.getPosition(i),4));
+}
+
+// Check that batched move selection prefers merges and skips invalid moves.
+TEST(evaluatorTest, checkChooseMoves) {
+    heuristicEvaluator heuristic;
+    board mergeBoard(4);
+    board smallBoard(3);
+    mergeBoard.setBoardValues({{1024,1024,0,0},{0,0,0,0},{0,0,0,0},{0,0,0,0}});
+    smallBoard.setBoardValues({{2,0,0},{0,0,0},{0,0,0}});
+    std::vector<const board*> boards {&mergeBoard,&smallBoard};
+    std::vector<char> moves;
+
+    chooseMoves(boards,heuristic,moves);
+    ASSERT_EQ(moves.size(),2);
+    EXPECT_TRUE(moves.at(0) == UP || moves.at(0) == DOWN);
+    EXPECT_TRUE(moves.at(1) == DOWN || moves.at(1) == RIGHT);
+}
+
+// Check many AI sessions that share batched evaluations.
+TEST(evaluatorTest, checkMoveBatcher) {
+    const unsigned nSessions = 32;
+    heuristicEvaluator heuristic;
+    sessionPool pool(4);
+    moveBatcher batcher(heuristic,pool,16);
+    std::vector<batchedPolicyInput> inputs(nSessions,batchedPolicyInput(batcher));
+    std::vector<session> games;
+    for(unsigned i = 0; i < nSessions; ++i) games.push_back(session(4,&inputs.at(i),i));
+    for(unsigned i = 0; i < nSessions; ++i) {
+        inputs.at(i).attach(games.at(i));
+        pool.add(games.at(i));
+    }
+    pool.waitAll();
+
+    for(const session& game : games) EXPECT_EQ(game.isFinished(),true);
+    EXPECT_GT(batcher.getBatchCount(),0);
+}
+
+// Check arena allocation, reuse after reset and peak usage.
+TEST(arenaTest, checkAllocate) {
+    arena memory(1024);
+
+    char* a = memory.allocateArray<char>(3);
+    double* b = memory.allocateArray<double>(10);
+    EXPECT_EQ(reinterpret_cast<std::size_t>(b) % alignof(double),0);
+    EXPECT_NE(static_cast<void*>(a),static_cast<void*>(b));
+
+    // Requests larger than a block get their own block.
+    memory.allocateArray<char>(4096);
+    EXPECT_GE(memory.getCapacity(),4096+1024);
+    std::size_t peak = memory.getPeakUsage();
+    EXPECT_GE(peak,3+80+4096);
+
+    // Rewinding and resetting reuse the memory.
+    arena::marker start = memory.mark();
+    char* c = memory.allocateArray<char>(16);
+    memory.rewind(start);
+    EXPECT_EQ(memory.allocateArray<char>(16),c);
+    peak = memory.getPeakUsage();
+    memory.reset();
+    EXPECT_EQ(memory.getUsage(),0);
+    EXPECT_EQ(memory.allocateArray<char>(3),a);
+    EXPECT_EQ(memory.getPeakUsage(),peak);
+
+    // Standard containers can use the arena.
+    std::vector<unsigned,arenaAllocator<unsigned> > values{arenaAllocator<unsigned>(memory)};
+    for(unsigned i = 0; i < 1000; ++i) values.push_back(i);
+    EXPECT_EQ(values.at(999),999);
+}
+
+// Check that moving a raw position gives the same result as board::move.
+TEST(positionTest, checkMovePosition) {
+    std::mt19937 mt(3);
+    for(unsigned size = 2; size <= 6; ++size) {
+        board myBoard(size,1u << 30);
+        std::vector<unsigned char> result(size*size);
+        for(unsigned i = 0; i < 2000; ++i) {
+            if(!myBoard.addRandomValue(mt)) myBoard.zero();
+            if(countEmptyCells(myBoard.getExponents().data(),size) == 0) continue;
+            char direction = "wasd"[mt() % 4];
+            unsigned positionScore = 0;
+            unsigned boardScore = 0;
+            bool changed = movePosition(myBoard.getExponents().data(),result.data(),size,direction,positionScore);
+            gameState_t moveState = myBoard.move(direction,boardScore);
+            EXPECT_EQ(changed,moveState != INVALID);
+            EXPECT_EQ(positionScore,boardScore);
+            EXPECT_EQ(result,myBoard.getExponents());
+        }
+    }
+}
+
+// Check that the search finds obvious moves and can play a whole game.
+TEST(searchTest, checkExpectimax) {
+    heuristicEvaluator heuristic;
+    expectimaxSearch searcher(heuristic);
+    board myBoard(4);
+
+    myBoard.setBoardValues({{2,4,8,16},{4,8,16,32},{8,16,32,64},{16,32,64,0}});
+    searchResult result = searcher.search(myBoard,2);
+    EXPECT_TRUE(result.move == DOWN || result.move == RIGHT);
+    EXPECT_GT(result.nodes,0);
+    EXPECT_GT(result.arenaPeak,0);
+
+    policyInput searchPolicy([&searcher](const board& gameBoard) { return searcher.search(gameBoard,2).move; });
+    session game(3,&searchPolicy,5);
+    EXPECT_EQ(game.resume(),true);
+    EXPECT_EQ(game.getMoveState(),LOOSE);
+}
+
+// Check nested task groups on the work-stealing pool.
+TEST(threadPoolTest, checkTaskGroups) {
+    threadPool pool(4);
+    std::atomic<unsigned> sum(0);
+    taskGroup outer(pool);
+    for(unsigned i = 0; i < 16; ++i) {
+        outer.run([&pool,&sum]() {
+            taskGroup inner(pool);
+            for(unsigned j = 0; j < 16; ++j) inner.run([&sum]() { ++sum; });
+            inner.wait();
+        });
+    }
+    outer.wait();
+    EXPECT_EQ(sum,256);
+    EXPECT_EQ(pool.getThreadCount(),4);
+}
+
+// Check the transposition table.
+TEST(searchTest, checkCache) {
+    transpositionTable cache(16,4);
+    std::vector<unsigned char> cells {1,2,3,4};
+    uint64_t key = transpositionTable::hashPosition(cells.data(),2);
+    double value;
+
+    EXPECT_EQ(cache.lookup(key,1,value),false);
+    cache.store(key,1,3.5);
+    EXPECT_EQ(cache.lookup(key,2,value),false);
+    EXPECT_EQ(cache.lookup(key,1,value),true);
+    EXPECT_EQ(value,3.5);
+    EXPECT_EQ(cache.getHitCount(),1);
+    EXPECT_EQ(cache.getLookupCount(),3);
+    cells.at(0) = 2;
+    EXPECT_NE(transpositionTable::hashPosition(cells.data(),2),key);
+
+    // All slots are used: 1024 random positions in 1024 slots leave about 1-1/e of them retrievable.
+    std::mt19937 mt(5);
+    transpositionTable small(1024,16);
+    std::vector<uint64_t> keys;
+    std::vector<unsigned char> position(16);
+    for(unsigned i = 0; i < 1024; ++i) {
+        for(unsigned char& cell : position) cell = mt() % 12;
+        keys.push_back(transpositionTable::hashPosition(position.data(),4));
+        small.store(keys.back(),1,double(i));
+    }
+    unsigned nFound = 0;
+    for(const uint64_t storedKey : keys) if(small.lookup(storedKey,1,value)) ++nFound;
+    EXPECT_GT(nFound,580);
+}
+
+// Check that the parallel, cached search gives the same result as the serial one.
+TEST(searchTest, checkParallelExpectimax) {
+    heuristicEvaluator heuristic;
+    expectimaxSearch serial(heuristic);
+    expectimaxSearch parallel(heuristic);
+    threadPool pool(4);
+    transpositionTable cache;
+    parallel.setThreadPool(&pool,1);
+    parallel.setCache(&cache);
+
+    std::mt19937 mt(11);
+    board myBoard(4);
+    unsigned score = 0;
+    for(unsigned i = 0; i < 10; ++i) {
+        myBoard.addRandomValue(mt);
+        searchResult serialResult = serial.search(myBoard,3);
+        searchResult parallelResult = parallel.search(myBoard,3);
+        EXPECT_EQ(serialResult.move,parallelResult.move);
+        EXPECT_EQ(serialResult.value,parallelResult.value);
+        myBoard.move(serialResult.move,score);
+    }
+    EXPECT_GT(cache.getHitCount(),0);
+}
+
+// Check iterative deepening against fixed-depth search and the deadline.
+TEST(searchTest, checkIterativeDeepening) {
+    heuristicEvaluator heuristic;
+    expectimaxSearch searcher(heuristic);
+    transpositionTable cache;
+    searcher.setCache(&cache);
+    board myBoard(4);
+    myBoard.setBoardValues({{2,4,0,0},{0,2,0,0},{0,0,0,0},{8,0,0,2}});
+
+    // Without time pressure the deepest pass is the fixed-depth search.
+    searchResult fixed = searcher.search(myBoard,2);
+    searchResult iterative = searcher.searchUntil(myBoard,std::chrono::steady_clock::now() + std::chrono::hours(1),2);
+    EXPECT_EQ(iterative.depth,2);
+    EXPECT_EQ(iterative.move,fixed.move);
+    EXPECT_EQ(iterative.value,fixed.value);
+
+    // An open 6x6 board cannot be searched deeply, the deadline has to hold anyway.
+    board largeBoard(6);
+    largeBoard.setBoardValues({{2,0,0,0,0,0},{0,0,0,0,0,0},{0,0,4,0,0,0},{0,0,0,0,0,0},{0,0,0,0,0,0},{0,0,0,0,0,2}});
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    searchResult timed = searcher.searchUntil(largeBoard,start + std::chrono::milliseconds(50));
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(timed.depth,1);
+    EXPECT_LT(timed.depth,32);
+    EXPECT_NE(timed.move,QUIT);
+    EXPECT_LT(elapsed,std::chrono::milliseconds(250));
+
+    // A deadline in the past still gives a move from depth 1.
+    searchResult late = searcher.searchUntil(largeBoard,start);
+    EXPECT_EQ(late.depth,1);
+    EXPECT_NE(late.move,QUIT);
+}
+
+// Check that a deepening run reuses the deeper values of an earlier search.
+TEST(searchTest, checkDeepeningReuse) {
+    heuristicEvaluator heuristic;
+    board myBoard(4);
+    myBoard.setBoardValues({{2,4,8,0},{0,2,0,0},{0,0,4,0},{2,0,0,0}});
+    const std::chrono::steady_clock::time_point never = std::chrono::steady_clock::now() + std::chrono::hours(1);
+
+    transpositionTable coldCache;
+    expectimaxSearch cold(heuristic);
+    cold.setCache(&coldCache);
+    searchResult coldResult = cold.searchUntil(myBoard,never,3);
+
+    // The warm cache holds the values of a depth 3 search, like after pondering.
+    transpositionTable warmCache;
+    expectimaxSearch warm(heuristic);
+    warm.setCache(&warmCache);
+    warm.search(myBoard,3);
+    unsigned long warmLookups = warmCache.getLookupCount();
+    unsigned long warmHits = warmCache.getHitCount();
+    searchResult warmResult = warm.searchUntil(myBoard,never,3);
+    warmLookups = warmCache.getLookupCount() - warmLookups;
+    warmHits = warmCache.getHitCount() - warmHits;
+
+    EXPECT_EQ(warmResult.move,coldResult.move);
+    EXPECT_EQ(warmResult.value,coldResult.value);
+    EXPECT_LT(warmResult.nodes,coldResult.nodes);
+    ASSERT_GT(warmLookups,0u);
+    EXPECT_GT(double(warmHits)/warmLookups,double(coldCache.getHitCount())/coldCache.getLookupCount());
+}
+
+// Check packed 4x4 moves against board::move, including tiles above 32768.
+TEST(packedTest, checkMovePacked) {
+    std::mt19937 mt(17);
+    board myBoard(4,1u << 30);
+    std::vector<unsigned char> cells(16);
+    for(unsigned i = 0; i < 20000; ++i) {
+        if(!myBoard.addRandomValue(mt)) myBoard.zero();
+        if(i % 100 == 0) myBoard(mt() % 4,mt() % 4) = 10 + mt() % 6;
+        if(myBoard.getEmptyCells().empty()) continue;
+
+        packedBoard packed,moved;
+        ASSERT_TRUE(packBoard(myBoard.getExponents().data(),packed));
+        unpackBoard(packed,cells.data());
+        EXPECT_EQ(cells,myBoard.getExponents());
+        EXPECT_EQ(transposePacked(transposePacked(packed)),packed);
+
+        char direction = "wasd"[mt() % 4];
+        unsigned packedScore = 0;
+        unsigned boardScore = 0;
+        bool fits = movePacked(packed,direction,moved,packedScore);
+        gameState_t moveState = myBoard.move(direction,boardScore);
+        if(myBoard.getMaxTile() > 32768) {
+            EXPECT_FALSE(fits);
+            myBoard.zero();
+            continue;
+        }
+        ASSERT_TRUE(fits);
+        EXPECT_EQ(moved != packed,moveState != INVALID);
+        EXPECT_EQ(packedScore,boardScore);
+        unpackBoard(moved,cells.data());
+        EXPECT_EQ(cells,myBoard.getExponents());
+    }
+
+    // The table path of movePosition falls back for tiles above 32768.
+    std::vector<unsigned char> overflow {15,15,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0};
+    unsigned score = 0;
+    EXPECT_TRUE(movePosition(overflow.data(),cells.data(),4,UP,score));
+    EXPECT_EQ(cells.at(0),16);
+    EXPECT_EQ(score,65536);
+}
+
+// Check that the table evaluator gives the same values as the heuristic evaluator.
+TEST(evaluatorTest, checkTableEvaluator) {
+    std::mt19937 mt(19);
+    heuristicEvaluator heuristic;
+    tableEvaluator table;
+    for(unsigned size = 3; size <= 5; ++size) {
+        std::vector<unsigned char> cells(size*size);
+        for(unsigned i = 0; i < 1000; ++i) {
+            for(unsigned char& cell : cells) cell = mt() % 17;
+            EXPECT_EQ(table.evaluate(cells.data(),size),heuristic.evaluate(cells.data(),size));
+        }
+    }
+}
+
+// Exact win probability by plain recursion, as an independent reference for the tablebase.
+static double exactWinProbability(const std::vector<unsigned char>& cells,const unsigned size,const unsigned targetExponent,std::map<std::vector<unsigned char>,double>& memo)
+{
+    auto known = memo.find(cells);
+    if(known != memo.end()) return known->second;
+
+    double best = 0.0;
+    if(countEmptyCells(cells.data(),size) > 0) {
+        for(const char direction : {UP,DOWN,LEFT,RIGHT}) {
+            board myBoard(size,tileValue(targetExponent));
+            myBoard.setExponents(cells);
+            unsigned score = 0;
+            gameState_t moveState = myBoard.move(direction,score);
+            if(moveState == INVALID) continue;
+            if(moveState == WIN) {
+                best = 1.0;
+                break;
+            }
+            double value = 0.0;
+            std::vector<std::tuple<unsigned,unsigned> > emptyCells = myBoard.getEmptyCells();
+            for(const std::tuple<unsigned,unsigned>& cell : emptyCells) {
+                std::vector<unsigned char> child = myBoard.getExponents();
+                child.at(std::get<0>(cell)*size + std::get<1>(cell)) = 1;
+                value += 0.9*exactWinProbability(child,size,targetExponent,memo);
+                child.at(std::get<0>(cell)*size + std::get<1>(cell)) = 2;
+                value += 0.1*exactWinProbability(child,size,targetExponent,memo);
+            }
+            best = std::max(best,value/emptyCells.size());
+        }
+    }
+    memo[cells] = best;
+    return best;
+}
+
+// Check generated tablebases against plain recursion, the file format and the search probe.
+TEST(tablebaseTest, checkGenerate) {
+    threadPool pool(4);
+    tablebase smallTable;
+    ASSERT_TRUE(smallTable.generate(2,5,pool));
+    EXPECT_EQ(tablebase::stateCount(2,5),625);
+
+    std::map<std::vector<unsigned char>,double> memo;
+    std::vector<unsigned char> cells(4);
+    for(unsigned index = 0; index < 625; ++index) {
+        for(unsigned i = 0, remainder = index; i < 4; ++i, remainder /= 5) cells.at(i) = remainder % 5;
+        ASSERT_TRUE(smallTable.covers(cells.data(),2));
+        EXPECT_NEAR(smallTable.probe(cells.data()),exactWinProbability(cells,2,5,memo),1e-4);
+    }
+
+    // A 3x3 table, saved and memory-mapped again.
+    tablebase table;
+    ASSERT_TRUE(table.generate(3,5,pool));
+    std::string path = temporaryPath(".tb");
+    ASSERT_TRUE(table.save(path));
+    tablebase mapped;
+    ASSERT_TRUE(mapped.load(path));
+    unlink(path.c_str());
+    EXPECT_EQ(mapped.getSize(),3);
+    EXPECT_EQ(mapped.getTargetExponent(),5);
+    std::vector<unsigned char> position {1,2,0, 3,0,0, 1,0,0};
+    EXPECT_EQ(mapped.probe(position.data()),table.probe(position.data()));
+    EXPECT_GT(mapped.probe(position.data()),0.0);
+    position.at(0) = 5;
+    EXPECT_FALSE(mapped.covers(position.data(),3));
+
+    // Headers of sizes or win tiles that generate() rejects are refused, even if
+    // the state count and the file size match.
+    auto writeHeader = [&path](const uint32_t size,const uint32_t targetExponent,const uint64_t nStates) {
+        std::ofstream file(path.c_str(),std::ios::binary);
+        const uint32_t fields[4] = {1,size,targetExponent,16};
+        file.write("G2048TB",8);
+        file.write(reinterpret_cast<const char*>(fields),sizeof(fields));
+        file.write(reinterpret_cast<const char*>(&nStates),sizeof(nStates));
+        std::vector<char> values(2*nStates,0);
+        file.write(values.data(),values.size());
+    };
+    writeHeader(3,5,1953125);
+    EXPECT_TRUE(tablebase().load(path));
+    writeHeader(7,1,1);
+    EXPECT_FALSE(tablebase().load(path));
+    writeHeader(8,2,0);
+    EXPECT_FALSE(tablebase().load(path));
+    writeHeader(2,2,16);
+    EXPECT_FALSE(tablebase().load(path));
+    unlink(path.c_str());
+
+    // The search answers covered positions from the tablebase.
+    heuristicEvaluator heuristic;
+    expectimaxSearch searcher(heuristic);
+    searcher.setTablebase(&mapped);
+    board myBoard(3,32);
+    myBoard.setBoardValues({{2,4,0},{8,0,0},{2,0,0}});
+    searchResult result = searcher.search(myBoard,2);
+    EXPECT_TRUE(result.fromTablebase);
+    EXPECT_NE(result.move,QUIT);
+
+    // Boards that play to another win tile or have already won are searched.
+    board otherTarget(3,2048);
+    otherTarget.setBoardValues({{2,4,0},{8,0,0},{2,0,0}});
+    EXPECT_FALSE(searcher.search(otherTarget,2).fromTablebase);
+    board wonBoard(3,32,true);
+    wonBoard.setBoardValues({{2,4,0},{8,0,0},{2,0,0}});
+    wonBoard.setWon(true);
+    EXPECT_FALSE(searcher.search(wonBoard,2).fromTablebase);
+    EXPECT_FALSE(tablebase().generate(4,8,pool));
+}
+
+// Check the quantiles of a sketch and that merging sketches loses nothing.
+TEST(statisticsTest, checkQuantileSketch) {
+    quantileSketch sketch(0.01);
+    EXPECT_EQ(sketch.quantile(0.5),0.0);
+    for(unsigned i = 1; i <= 10000; ++i) sketch.add(i);
+    EXPECT_EQ(sketch.getCount(),10000u);
+    EXPECT_NEAR(sketch.quantile(0.5),5000,5000*0.01);
+    EXPECT_NEAR(sketch.quantile(0.99),9900,9900*0.01);
+    EXPECT_EQ(sketch.quantile(0),1.0);
+    EXPECT_EQ(sketch.quantile(1),10000.0);
+
+    // Merging two halves gives the same sketch as adding everything.
+    quantileSketch low, high, all;
+    for(unsigned i = 0; i < 500; ++i) {
+        low.add(i);
+        all.add(i);
+    }
+    for(unsigned i = 500; i < 100000; i += 7) {
+        high.add(i);
+        all.add(i);
+    }
+    high.merge(low);
+    EXPECT_EQ(high.getCount(),all.getCount());
+    for(double q = 0; q <= 1; q += 0.125) EXPECT_EQ(high.quantile(q),all.quantile(q));
+}
+
+// Check recording and merging game statistics and their summary.
+TEST(statisticsTest, checkRecordAndMerge) {
+    simulationStatistics first, second;
+    first.record(WIN,false,20000,2048,900);
+    first.record(LOOSE,false,3000,256,250);
+    second.record(LOOSE,false,7000,512,400);
+    second.record(UNFINISHED,true,100,16,10);
+    first.merge(second);
+    EXPECT_EQ(first.getGameCount(),4u);
+    EXPECT_EQ(first.getOutcomeCount(WIN),1u);
+    EXPECT_EQ(first.getOutcomeCount(LOOSE),2u);
+    EXPECT_EQ(first.getQuitCount(),1u);
+    EXPECT_DOUBLE_EQ(first.getMeanScore(),(20000+3000+7000+100)/4.0);
+    EXPECT_EQ(first.getMaxTileCount(11),1u);
+    EXPECT_EQ(first.getMaxTileCount(9),1u);
+    EXPECT_EQ(first.getMaxTileCount(10),0u);
+    EXPECT_EQ(first.getLengths().quantile(1),900.0);
+    std::ostringstream summary;
+    first.print(summary);
+    EXPECT_NE(summary.str().find("won 1, lost 2, quit 1"),std::string::npos);
+}
+
+// A simulation of nGames greedy games of eval on nThreads threads (eval has to outlive it).
+static simulationConfig greedySimulation(const evaluator& eval,const unsigned long nGames,const unsigned nThreads,const unsigned seed)
+{
+    simulationConfig config;
+    config.nGames = nGames;
+    config.nThreads = nThreads;
+    config.seed = seed;
+    config.makePolicy = [&eval]() { return greedyPolicy(eval); };
+    return config;
+}
+
+// Check that simulations give the same result on every run and quit games at the move limit.
+TEST(simulationTest, checkDeterministic) {
+    heuristicEvaluator eval;
+    simulationConfig config = greedySimulation(eval,12,3,7);
+    config.winTile = 256;
+
+    // The result does not depend on how the threads interleave.
+    simulationStatistics first, second;
+    EXPECT_TRUE(runSimulation(config,first));
+    EXPECT_TRUE(runSimulation(config,second));
+    EXPECT_EQ(first.getGameCount(),12u);
+    EXPECT_EQ(first.getOutcomeCount(WIN)+first.getOutcomeCount(LOOSE)+first.getQuitCount(),12u);
+    EXPECT_EQ(first.getQuitCount(),0u);
+    EXPECT_EQ(first.getMeanScore(),second.getMeanScore());
+    EXPECT_EQ(first.getLengths().quantile(0.5),second.getLengths().quantile(0.5));
+    EXPECT_GT(first.getMeanScore(),0.0);
+
+    // Games are quit at the move limit.
+    config.maxMoves = 5;
+    simulationStatistics limited;
+    EXPECT_TRUE(runSimulation(config,limited));
+    EXPECT_EQ(limited.getQuitCount(),12u);
+    EXPECT_EQ(limited.getLengths().quantile(1),5.0);
+}
+
+// Check that a written session continues exactly like the original one.
+TEST(simulationTest, checkSessionRoundTrip) {
+    session original(4,NULL,11,64,true);
+    for(unsigned i = 0; i < 20; ++i) original.step(i%2 == 0 ? LEFT : UP);
+    std::stringstream stream;
+    original.write(stream);
+    session restored(4,NULL,0,64,true);
+    ASSERT_TRUE(restored.read(stream));
+    EXPECT_EQ(restored.getScore(),original.getScore());
+    EXPECT_EQ(restored.getBoard().getExponents(),original.getBoard().getExponents());
+
+    // Both games spawn the same tiles from now on.
+    const char moves[4] = {DOWN,RIGHT,UP,LEFT};
+    for(unsigned i = 0; i < 40; ++i) {
+        EXPECT_EQ(restored.step(moves[i%4]),original.step(moves[i%4]));
+    }
+    EXPECT_EQ(restored.getBoard().getExponents(),original.getBoard().getExponents());
+    session otherSize(3,NULL,0);
+    stream.seekg(0);
+    EXPECT_FALSE(otherSize.read(stream));
+}
+
+// Check that a killed run continues from its checkpoint with the result of an uninterrupted run.
+TEST(simulationTest, checkCheckpointResume) {
+    heuristicEvaluator eval;
+    simulationConfig config = greedySimulation(eval,40,2,3);
+    config.winTile = 512;
+    simulationStatistics uninterrupted;
+    ASSERT_TRUE(runSimulation(config,uninterrupted));
+
+    // Without an interval the workers snapshot at every move, a worker kills the
+    // run in the middle of its first game once a checkpoint has been written.
+    config.checkpointPath = temporaryPath(".cp");
+    config.checkpointInterval = std::chrono::milliseconds(0);
+    unlink(config.checkpointPath.c_str());
+    pid_t child = fork();
+    ASSERT_GE(child,0);
+    if(child == 0) {
+        const std::string path = config.checkpointPath;
+        config.makePolicy = [&eval,path]() {
+            movePolicy greedy = greedyPolicy(eval);
+            unsigned nMoves = 0;
+            return movePolicy([greedy,path,nMoves](const board& gameBoard) mutable {
+                if(++nMoves > 100 && access(path.c_str(),F_OK) == 0) raise(SIGKILL);
+                return greedy(gameBoard);
+            });
+        };
+        simulationStatistics ignored;
+        runSimulation(config,ignored);
+        _exit(0);
+    }
+    int status;
+    waitpid(child,&status,0);
+    EXPECT_TRUE(WIFSIGNALED(status));
+
+    simulationStatistics resumed;
+    ASSERT_TRUE(runSimulation(config,resumed));
+    EXPECT_EQ(resumed.getGameCount(),uninterrupted.getGameCount());
+    EXPECT_EQ(resumed.getOutcomeCount(WIN),uninterrupted.getOutcomeCount(WIN));
+    EXPECT_EQ(resumed.getMeanScore(),uninterrupted.getMeanScore());
+    for(double q = 0; q <= 1; q += 0.25) {
+        EXPECT_EQ(resumed.getScores().quantile(q),uninterrupted.getScores().quantile(q));
+        EXPECT_EQ(resumed.getLengths().quantile(q),uninterrupted.getLengths().quantile(q));
+    }
+    for(unsigned i = 0; i < 16; ++i) EXPECT_EQ(resumed.getMaxTileCount(i),uninterrupted.getMaxTileCount(i));
+
+    // The finished checkpoint gives the result without playing, another configuration is refused.
+    simulationStatistics again;
+    ASSERT_TRUE(runSimulation(config,again));
+    EXPECT_EQ(again.getMeanScore(),uninterrupted.getMeanScore());
+
+    // A worker record that does not match its stored size is damaged.
+    std::fstream file(config.checkpointPath.c_str(),std::ios::binary | std::ios::in | std::ios::out);
+    const std::streamoff firstSnapshotSize = 8 + 4 + 29;
+    uint64_t snapshotSize;
+    file.seekg(firstSnapshotSize);
+    file.read(reinterpret_cast<char*>(&snapshotSize),sizeof(snapshotSize));
+    snapshotSize += 1;
+    file.seekp(firstSnapshotSize);
+    file.write(reinterpret_cast<const char*>(&snapshotSize),sizeof(snapshotSize));
+    file.close();
+    EXPECT_FALSE(runSimulation(config,again));
+
+    config.seed = 4;
+    EXPECT_FALSE(runSimulation(config,again));
+    unlink(config.checkpointPath.c_str());
+}
+
+// Check the order and capacity of the shared rings and pushing from a forked process.
+TEST(simulationTest, checkSharedRings) {
+    sharedRings rings;
+    ASSERT_TRUE(rings.create(2,4));
+    EXPECT_EQ(rings.getRingCount(),2u);
+    gameSummary summary = {100,16,10,LOOSE,0};
+    for(unsigned i = 0; i < 4; ++i) {
+        summary.score = i;
+        EXPECT_TRUE(rings.push(0,summary));
+    }
+    EXPECT_FALSE(rings.push(0,summary));
+    EXPECT_FALSE(rings.pop(1,summary));
+    for(unsigned i = 0; i < 6; ++i) {
+        ASSERT_TRUE(rings.pop(0,summary));
+        EXPECT_EQ(summary.score,i);
+        summary.score = i+4;
+        EXPECT_TRUE(rings.push(0,summary));
+    }
+
+    // The rings are shared with forked processes.
+    pid_t child = fork();
+    ASSERT_GE(child,0);
+    if(child == 0) {
+        gameSummary childSummary = {7,8,9,WIN,0};
+        while(!rings.push(1,childSummary)) {}
+        _exit(0);
+    }
+    waitpid(child,NULL,0);
+    ASSERT_TRUE(rings.pop(1,summary));
+    EXPECT_EQ(summary.score,7u);
+    EXPECT_EQ(summary.finalState,WIN);
+}
+
+// Check that worker processes give the results of threads and survive crashing workers.
+TEST(simulationTest, checkProcesses) {
+    heuristicEvaluator eval;
+    simulationConfig config = greedySimulation(eval,15,3,9);
+    config.winTile = 256;
+    simulationStatistics threads, processes;
+    ASSERT_TRUE(runSimulation(config,threads));
+    ASSERT_TRUE(runSimulationProcesses(config,processes));
+    EXPECT_EQ(processes.getGameCount(),15u);
+    EXPECT_EQ(processes.getOutcomeCount(WIN),threads.getOutcomeCount(WIN));
+    EXPECT_EQ(processes.getMeanScore(),threads.getMeanScore());
+    EXPECT_EQ(processes.getLengths().quantile(0.5),threads.getLengths().quantile(0.5));
+
+    // A crashing policy loses the games of its process, the others are still collected.
+    config.makePolicy = [&eval]() {
+        movePolicy greedy = greedyPolicy(eval);
+        return [greedy](const board& gameBoard) {
+            if(gameBoard.getMaxTile() >= 64) raise(SIGKILL);
+            return greedy(gameBoard);
+        };
+    };
+    config.winTile = 32;
+    simulationStatistics crashed;
+    EXPECT_TRUE(runSimulationProcesses(config,crashed));
+    config.winTile = 256;
+    EXPECT_FALSE(runSimulationProcesses(config,crashed));
+    EXPECT_LT(crashed.getGameCount(),15u);
+}
+
+// Check that written shards are read back with their positions, moves and value targets.
+TEST(datasetTest, checkShards) {
+    std::string prefix = temporaryPath("");
+    datasetWriter writer(prefix,4,100);
+
+    // 3 games with 70 moves each fill two complete shards and a partial one.
+    std::vector<unsigned char> cells(16);
+    for(unsigned game = 0; game < 3; ++game) {
+        for(unsigned move = 0; move < 70; ++move) {
+            for(unsigned i = 0; i < 16; ++i) cells[i] = (game+move+i)%18;
+            writer.addMove(cells.data(),move%2 == 0 ? LEFT : UP,10*move);
+        }
+        EXPECT_TRUE(writer.endGame(1000+game));
+    }
+    writer.addMove(cells.data(),DOWN,0);
+    EXPECT_TRUE(writer.close());
+    EXPECT_EQ(writer.getRowCount(),210u);
+    EXPECT_EQ(writer.getShardCount(),3u);
+
+    uint64_t row = 0;
+    for(unsigned shard = 0; shard < 3; ++shard) {
+        datasetShard reader;
+        std::string path = datasetWriter::shardPath(prefix,shard);
+        ASSERT_TRUE(reader.open(path));
+        unlink(path.c_str());
+        EXPECT_EQ(reader.getRowCount(),shard < 2 ? 100u : 10u);
+        EXPECT_EQ(reader.getPositionBytes(),16u);
+        for(uint64_t i = 0; i < reader.getRowCount(); ++i, ++row) {
+            unsigned game = row/70, move = row%70;
+            reader.getPosition(i,cells.data());
+            for(unsigned j = 0; j < 16; ++j) EXPECT_EQ(cells[j],(game+move+j)%18);
+            EXPECT_EQ(reader.getMoves()[i],move%2 == 0 ? LEFT : UP);
+            EXPECT_EQ(reader.getFinalScores()[i],1000+game);
+            EXPECT_EQ(reader.getValueTargets()[i],float(1000+game-10*move));
+        }
+    }
+    EXPECT_FALSE(datasetShard().open(datasetWriter::shardPath(prefix,3)));
+
+    // Tiles above 32768 are stored exactly, here a 65536.
+    datasetWriter largeWriter(prefix,4);
+    cells = {16,2,3,4, 0,0,5,6, 7,0,0,0, 1,1,2,17};
+    largeWriter.addMove(cells.data(),RIGHT,4);
+    largeWriter.endGame(8);
+    ASSERT_TRUE(largeWriter.close());
+    datasetShard largeReader;
+    ASSERT_TRUE(largeReader.open(datasetWriter::shardPath(prefix,0)));
+    unlink(datasetWriter::shardPath(prefix,0).c_str());
+    std::vector<unsigned char> stored(16);
+    largeReader.getPosition(0,stored.data());
+    EXPECT_EQ(stored,cells);
+    EXPECT_EQ(tileValue(largeReader.getPositions()[0]),65536u);
+}
+
+// Check the shards exported by simulations.
+TEST(datasetTest, checkSimulationExport) {
+    heuristicEvaluator eval;
+    simulationConfig config = greedySimulation(eval,6,2,0);
+    config.maxMoves = 30;
+    config.boardSize = 5;
+    config.exportPrefix = temporaryPath("");
+    simulationStatistics stats;
+    ASSERT_TRUE(runSimulation(config,stats));
+
+    // Every game reached the move limit, each worker wrote one shard.
+    for(unsigned worker = 0; worker < 2; ++worker) {
+        datasetShard reader;
+        std::string path = datasetWriter::shardPath(config.exportPrefix + "-" + std::to_string(worker),0);
+        ASSERT_TRUE(reader.open(path));
+        unlink(path.c_str());
+        EXPECT_EQ(reader.getBoardSize(),5u);
+        EXPECT_EQ(reader.getPositionBytes(),25u);
+        ASSERT_EQ(reader.getRowCount(),90u);
+        // The value target of the first move of a game is its whole score.
+        EXPECT_EQ(reader.getValueTargets()[0],float(reader.getFinalScores()[0]));
+        for(unsigned i = 1; i < 30; ++i) {
+            EXPECT_EQ(reader.getFinalScores()[i],reader.getFinalScores()[0]);
+            EXPECT_LE(reader.getValueTargets()[i],reader.getValueTargets()[i-1]);
+        }
+    }
+
+    // Worker processes export the same shards.
+    ASSERT_TRUE(runSimulationProcesses(config,stats));
+    for(unsigned worker = 0; worker < 2; ++worker) {
+        datasetShard reader;
+        std::string path = datasetWriter::shardPath(config.exportPrefix + "-" + std::to_string(worker),0);
+        ASSERT_TRUE(reader.open(path));
+        unlink(path.c_str());
+        EXPECT_EQ(reader.getRowCount(),90u);
+    }
+
+    config.checkpointPath = config.exportPrefix + ".cp";
+    EXPECT_FALSE(runSimulation(config,stats));
+    config.exportPrefix.clear();
+    EXPECT_FALSE(runSimulationProcesses(config,stats));
+}
+
+// Check that pondering warms the cache for the next search and stops quickly.
+TEST(ponderTest, checkWarmsCache) {
+    heuristicEvaluator eval;
+    board myBoard(4);
+    myBoard.setBoardValues({{2,4,8,0},{0,2,0,0},{0,0,4,0},{2,0,0,0}});
+
+    // Ponder three moves ahead, then search a position after a move and a spawn.
+    transpositionTable warmCache;
+    {
+        ponderer background(eval,warmCache,3);
+        background.start(myBoard);
+        while(background.getPonderedDepth() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        EXPECT_EQ(background.getPonderedDepth(),3u);
+    }
+    board next = myBoard;
+    unsigned score = 0;
+    ASSERT_NE(next.move(LEFT,score),INVALID);
+    next(3,3) = 1;
+    expectimaxSearch warm(eval), cold(eval);
+    warm.setCache(&warmCache);
+    transpositionTable coldCache;
+    cold.setCache(&coldCache);
+    searchResult warmResult = warm.search(next,2);
+    searchResult coldResult = cold.search(next,2);
+    EXPECT_EQ(warmResult.move,coldResult.move);
+    EXPECT_DOUBLE_EQ(warmResult.value,coldResult.value);
+    EXPECT_LT(warmResult.nodes,coldResult.nodes);
+
+    // Stopping interrupts a deep search quickly.
+    ponderer deep(eval,warmCache,20);
+    deep.start(myBoard);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto before = std::chrono::steady_clock::now();
+    deep.stop();
+    EXPECT_LT(std::chrono::steady_clock::now()-before,std::chrono::milliseconds(500));
+    EXPECT_EQ(deep.getPonderedDepth(),0u);
+}
+
+// Check hints and the automove of assisted input.
+TEST(ponderTest, checkAssistedInput) {
+    heuristicEvaluator eval;
+    transpositionTable cache;
+    expectimaxSearch hints(eval);
+    hints.setCache(&cache);
+    ponderer background(eval,cache,4);
+    queueInput keys;
+    std::vector<searchResult> shown;
+    assistedInput assistant(keys,background,hints,std::chrono::milliseconds(20),[&shown](const searchResult& hint) {
+        shown.push_back(hint);
+    });
+
+    // Only DOWN is valid, so the timed hint and automove searches agree whatever depth they reach.
+    board myBoard(4);
+    myBoard.setBoardValues({{2,4,8,0},{4,8,2,0},{2,4,8,0},{4,8,2,0}});
+    char key;
+    EXPECT_FALSE(assistant.nextKey(myBoard,key));
+    keys.push(HINT);
+    keys.push(AUTOMOVE);
+    keys.push(DOWN);
+    ASSERT_TRUE(assistant.nextKey(myBoard,key));
+    ASSERT_EQ(shown.size(),1u);
+    EXPECT_EQ(shown[0].move,DOWN);
+    EXPECT_EQ(key,DOWN);
+    ASSERT_TRUE(assistant.nextKey(myBoard,key));
+    EXPECT_EQ(key,DOWN);
+}
+
+// Check keys read from a pipe: skipped bytes, split escape sequences and the end of input.
+TEST(keyboardTest, checkPipedKeys) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds),0);
+    board myBoard(4);
+    char key;
+    {
+        keyboardInput keyboard(fds[0]);
+        EXPECT_FALSE(keyboard.isRawMode());
+
+        // Keys in one write, other bytes skipped, an arrow key split over two writes.
+        std::string first = "wx\na\033[A\033[";
+        ASSERT_EQ(write(fds[1],first.data(),first.size()),ssize_t(first.size()));
+        const char expected[3] = {UP,LEFT,UP};
+        for(unsigned i = 0; i < 3; ++i) {
+            ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+            EXPECT_EQ(key,expected[i]);
+        }
+        std::string second = "Cdh\033OB";
+        ASSERT_EQ(write(fds[1],second.data(),second.size()),ssize_t(second.size()));
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,RIGHT);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,RIGHT);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,DOWN);
+
+        // The end of the input quits.
+        close(fds[1]);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,QUIT);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,QUIT);
+    }
+    close(fds[0]);
+
+    // A reader that is destroyed while waiting for input.
+    ASSERT_EQ(pipe(fds),0);
+    {
+        keyboardInput keyboard(fds[0],true);
+        std::string keys = "hm";
+        ASSERT_EQ(write(fds[1],keys.data(),keys.size()),ssize_t(keys.size()));
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,HINT);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,AUTOMOVE);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Check raw mode on a pseudo terminal: Ctrl-C quits and a fatal signal restores the mode.
+TEST(keyboardTest, checkTerminal) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    ASSERT_GE(master,0);
+    ASSERT_EQ(grantpt(master),0);
+    ASSERT_EQ(unlockpt(master),0);
+    int slave = open(ptsname(master),O_RDWR | O_NOCTTY);
+    ASSERT_GE(slave,0);
+    struct termios mode;
+    ASSERT_EQ(tcgetattr(slave,&mode),0);
+    ASSERT_TRUE(mode.c_lflag & ECHO);
+
+    board myBoard(4);
+    char key;
+    {
+        keyboardInput keyboard(slave);
+        EXPECT_TRUE(keyboard.isRawMode());
+        ASSERT_EQ(tcgetattr(slave,&mode),0);
+        EXPECT_FALSE(mode.c_lflag & (ECHO | ICANON | ISIG));
+        ASSERT_EQ(write(master,"a\003",2),2);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,LEFT);
+        ASSERT_TRUE(keyboard.nextKey(myBoard,key));
+        EXPECT_EQ(key,QUIT);
+    }
+    ASSERT_EQ(tcgetattr(slave,&mode),0);
+    EXPECT_TRUE(mode.c_lflag & ECHO);
+
+    // A process killed while in raw mode leaves the terminal as it found it.
+    pid_t pid = fork();
+    ASSERT_GE(pid,0);
+    if(pid == 0) {
+        keyboardInput keyboard(slave);
+        raise(keyboard.isRawMode() ? SIGTERM : SIGKILL);
+        _exit(0);
+    }
+    int status;
+    ASSERT_EQ(waitpid(pid,&status,0),pid);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    EXPECT_EQ(WTERMSIG(status),SIGTERM);
+    ASSERT_EQ(tcgetattr(slave,&mode),0);
+    EXPECT_TRUE(mode.c_lflag & ECHO);
+    EXPECT_TRUE(mode.c_lflag & ICANON);
+    close(slave);
+    close(master);
+}
+
+// Check that undo and redo restore every position, score and win state of a game.
+TEST(historyTest, checkUndoRedo) {
+    session game(4,NULL,5,16,true);
+    game.enableHistory();
+    std::vector<std::vector<unsigned char> > positions(1,game.getBoard().getExponents());
+    std::vector<unsigned> scores(1,0);
+    const char moves[4] = {LEFT,UP,RIGHT,DOWN};
+    for(unsigned i = 0; positions.size() < 30; ++i) {
+        if(game.step(moves[i%4]) == INVALID) continue;
+        positions.push_back(game.getBoard().getExponents());
+        scores.push_back(game.getScore());
+    }
+    ASSERT_TRUE(game.getBoard().hasWon());
+    EXPECT_EQ(game.getHistory()->getUndoCount(),29u);
+
+    // Step back to the start and forward again.
+    gameState_t lastState = game.getMoveState();
+    unsigned nObserved = 0;
+    game.setObserver([&nObserved](const session&,const gameState_t state) {
+        EXPECT_EQ(state,INVALID);
+        ++nObserved;
+    });
+    for(unsigned i = 29; i > 0; --i) {
+        game.step(UNDO);
+        EXPECT_EQ(game.getBoard().getExponents(),positions[i-1]);
+        EXPECT_EQ(game.getScore(),scores[i-1]);
+    }
+    EXPECT_FALSE(game.getBoard().hasWon());
+    EXPECT_EQ(game.getMoveState(),UNFINISHED);
+    game.step(UNDO);
+    EXPECT_EQ(nObserved,29u);
+    for(unsigned i = 1; i < 30; ++i) {
+        game.step(REDO);
+        EXPECT_EQ(game.getBoard().getExponents(),positions[i]);
+        EXPECT_EQ(game.getScore(),scores[i]);
+    }
+    EXPECT_TRUE(game.getBoard().hasWon());
+    EXPECT_EQ(game.getMoveState(),lastState);
+
+    // A new turn after an undo drops the redo turns.
+    game.setObserver(nullptr);
+    game.step(UNDO);
+    game.step(UNDO);
+    EXPECT_EQ(game.getHistory()->getRedoCount(),2u);
+    for(unsigned i = 0; game.step(moves[i%4]) == INVALID; ++i) {}
+    EXPECT_EQ(game.getHistory()->getRedoCount(),0u);
+    EXPECT_EQ(game.getHistory()->getUndoCount(),28u);
+
+    // Without a history undo does nothing.
+    session plain(4,NULL,5);
+    std::vector<unsigned char> start = plain.getBoard().getExponents();
+    EXPECT_EQ(plain.step(UNDO),INVALID);
+    EXPECT_EQ(plain.getBoard().getExponents(),start);
+}
+
+// Check that only the newest turns are kept, limited by turns or by cell changes.
+TEST(historyTest, checkBounded) {
+    boardHistory history(4,1000);
+    boardHistory changeLimited(100,10);
+    board myBoard(4);
+    std::vector<unsigned char> before(16,0);
+    unsigned score = 0;
+    for(unsigned i = 0; i < 10; ++i) {
+        myBoard.setExponents(before);
+        myBoard(i%4,0) = i+1;
+        myBoard(i%4,1) = 1;
+        history.record(before,myBoard,4,UNFINISHED,UNFINISHED,false);
+        changeLimited.record(before,myBoard,4,UNFINISHED,UNFINISHED,false);
+        before = myBoard.getExponents();
+        score += 4;
+    }
+    EXPECT_EQ(history.getUndoCount(),4u);
+    // The first 4 turns change 2 cells, the later ones 1.
+    EXPECT_EQ(changeLimited.getUndoCount(),8u);
+    gameState_t state = UNFINISHED;
+    while(history.undo(myBoard,score,state)) {}
+    EXPECT_EQ(score,40u-16u);
+    EXPECT_EQ(myBoard(1,0),6);
+    EXPECT_EQ(myBoard(2,0),3);
+    EXPECT_EQ(history.getRedoCount(),4u);
+}
+
+// Check undo on a 17x17 board, whose cell indices do not fit into a byte.
+TEST(historyTest, checkLargeBoard) {
+    session game(17,NULL,3);
+    ASSERT_TRUE(game.enableHistory());
+
+    // RIGHT moves the tiles to the last row, cells 272 to 288.
+    std::vector<unsigned char> start = game.getBoard().getExponents();
+    ASSERT_NE(game.step(RIGHT),INVALID);
+    std::vector<unsigned char> moved = game.getBoard().getExponents();
+    EXPECT_GT(std::count(moved.begin()+272,moved.end(),0),0);
+    EXPECT_LT(std::count(moved.begin()+272,moved.end(),0),17);
+    game.step(UNDO);
+    EXPECT_EQ(game.getBoard().getExponents(),start);
+    game.step(REDO);
+    EXPECT_EQ(game.getBoard().getExponents(),moved);
+
+    session huge(256,NULL,3);
+    EXPECT_FALSE(huge.enableHistory());
+    EXPECT_EQ(huge.getHistory(),(const boardHistory*)NULL);
+}
+
+// Check that the differential checker accepts any input and that a short run passes.
+TEST(fuzzTest, checkDifferentialChecker) {
+    differentialChecker checker;
+    std::string failure;
+    EXPECT_TRUE(checker.check(NULL,0,failure));
+
+    // 4x4 with two 32768 tiles in the first row, which the packed engine refuses to merge.
+    std::vector<uint8_t> overflow {2,0, 105,105,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 'w','a','s','d'};
+    EXPECT_TRUE(checker.check(overflow.data(),overflow.size(),failure)) << failure;
+    for(unsigned size = minFuzzSize; size <= maxFuzzSize; ++size) {
+        std::vector<uint8_t> input(2 + size*size + 64,200);
+        input.at(0) = uint8_t(size - minFuzzSize);
+        for(unsigned i = 2 + size*size; i < input.size(); ++i) input.at(i) = uint8_t(i*37);
+        EXPECT_TRUE(checker.check(input.data(),input.size(),failure)) << failure;
+    }
+
+    fuzzConfig config;
+    config.nCases = 2000;
+    config.nThreads = 2;
+    config.seed = 3;
+    std::ostringstream report;
+    EXPECT_TRUE(runDifferentialFuzz(config,report)) << report.str();
+    EXPECT_NE(report.str().find("Checked 2000 inputs"),std::string::npos);
+}
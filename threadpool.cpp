@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file threadpool.cpp
+ * \brief File contains the implementation of the work-stealing thread pool.
+ * 
+ */
+
+#include "threadpool.h"
+#include <cassert>
+
+// The pool and the worker index of the calling thread.
+static thread_local const threadPool* workerPool = NULL;
+static thread_local int workerId = -1;
+
+threadPool::threadPool(const unsigned nThreads) : nQueued(0), nextQueue(0), stopping(false)
+{
+    assert(nThreads > 0);
+    for(unsigned i = 0; i < nThreads; ++i) this->queues.push_back(std::unique_ptr<workerQueue>(new workerQueue));
+    for(unsigned i = 0; i < nThreads; ++i) this->workers.push_back(std::thread(&threadPool::work,this,i));
+}
+
+threadPool::~threadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->stopping = true;
+    }
+    this->sleepCondition.notify_all();
+    for(std::thread& worker : this->workers) worker.join();
+}
+
+int threadPool::currentWorker() const
+{
+    return workerPool == this ? workerId : -1;
+}
+
+void threadPool::submit(const std::function<void()>& task)
+{
+    // Workers push to their own queue, other threads spread their tasks.
+    int self = this->currentWorker();
+    unsigned id = self >= 0 ? unsigned(self) : this->nextQueue++ % this->queues.size();
+    {
+        std::lock_guard<std::mutex> lock(this->queues[id]->mutex);
+        this->queues[id]->tasks.push_back(task);
+    }
+    ++this->nQueued;
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+    }
+    this->sleepCondition.notify_one();
+}
+
+bool threadPool::runPendingTask()
+{
+    if(this->nQueued == 0) return false;
+
+    std::function<void()> task;
+    int self = this->currentWorker();
+    unsigned nQueues = this->queues.size();
+
+    // Take the newest task of the own queue, otherwise steal the oldest task of another queue.
+    for(unsigned i = 0; i < nQueues && !task; ++i) {
+        unsigned id = self >= 0 ? (unsigned(self) + i) % nQueues : i;
+        std::lock_guard<std::mutex> lock(this->queues[id]->mutex);
+        std::deque< std::function<void()> >& tasks = this->queues[id]->tasks;
+        if(tasks.empty()) continue;
+        if(int(id) == self) {
+            task.swap(tasks.back());
+            tasks.pop_back();
+        }
+        else {
+            task.swap(tasks.front());
+            tasks.pop_front();
+        }
+    }
+    if(!task) return false;
+
+    --this->nQueued;
+    task();
+    return true;
+}
+
+unsigned threadPool::getThreadCount() const
+{
+    return this->workers.size();
+}
+
+void threadPool::work(const unsigned id)
+{
+    workerPool = this;
+    workerId = int(id);
+    while(1) {
+        if(this->runPendingTask()) continue;
+
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        while(this->nQueued == 0 && !this->stopping) this->sleepCondition.wait(lock);
+        if(this->stopping) return;
+    }
+}
+
+taskGroup::taskGroup(threadPool& pool) : pool(pool), nPending(0)
+{
+}
+
+void taskGroup::run(const std::function<void()>& task)
+{
+    ++this->nPending;
+    this->pool.submit([this,task]() {
+        task();
+        --this->nPending;
+    });
+}
+
+void taskGroup::wait()
+{
+    // Help with queued tasks instead of blocking.
+    while(this->nPending > 0) {
+        if(!this->pool.runPendingTask()) std::this_thread::yield();
+    }
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015, Jochen Heil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Jochen Heil ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Jochen Heil BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*!\file threadpool.h
+ * \brief File contains the definition of the work-stealing thread pool and of
+ * task groups for fork-join parallelism.
+ * 
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+/*! \brief Thread pool in which idle workers steal tasks from busy ones.
+ *
+ *  Every worker owns a task queue. Tasks submitted by a worker go to its own
+ *  queue and are taken from the back (newest first), idle workers steal from
+ *  the front (oldest, usually largest tasks) of other queues.
+ */
+class threadPool
+{
+private:
+    /*! \brief The task queue of one worker.
+     *
+     */
+    struct workerQueue
+    {
+        std::mutex mutex; /*!< Protects the tasks. */
+        std::deque< std::function<void()> > tasks; /*!< The queued tasks. */
+    };
+
+    std::vector< std::unique_ptr<workerQueue> > queues; /*!< One queue per worker. */
+    std::vector<std::thread> workers; /*!< The worker threads. */
+    std::atomic<unsigned> nQueued; /*!< The number of queued tasks in all queues. */
+    std::atomic<unsigned> nextQueue; /*!< Round robin queue for tasks from outside the pool. */
+    std::mutex sleepMutex; /*!< Protects sleeping on sleepCondition. */
+    std::condition_variable sleepCondition; /*!< Signalled when a task is queued. */
+    bool stopping; /*!< Whether the workers should exit. */
+
+    /*! \brief Get the worker index of the calling thread.
+     * 
+     *  \return The worker index, or -1 if the thread does not belong to this pool.
+     */
+    int currentWorker() const;
+
+    /*! \brief Main loop of a worker thread.
+     * 
+     *  \param id The worker index.
+     */
+    void work(const unsigned id);
+
+public:
+    /*! \brief Make a new pool and start its worker threads.
+     * 
+     *  \param nThreads The number of worker threads.
+     */
+    threadPool(const unsigned nThreads);
+
+    ~threadPool(); /*!< Destructor that stops and joins the worker threads. */
+
+    /*! \brief Queue a task.
+     * 
+     *  \param task The task.
+     */
+    void submit(const std::function<void()>& task);
+
+    /*! \brief Run one queued task on the calling thread, if there is one.
+     * 
+     *  \return Whether a task was run.
+     */
+    bool runPendingTask();
+
+    /*! \brief Get the number of worker threads.
+     * 
+     *  \return The number of worker threads.
+     */
+    unsigned getThreadCount() const;
+};
+
+/*! \brief A group of tasks that can be waited for.
+ *
+ *  wait() runs queued tasks while the group is not finished, so groups can be
+ *  nested inside tasks without blocking workers.
+ */
+class taskGroup
+{
+private:
+    threadPool& pool; /*!< The pool that runs the tasks. */
+    std::atomic<unsigned> nPending; /*!< Tasks of the group that have not finished. */
+public:
+    /*! \brief Make a new, empty group.
+     * 
+     *  \param pool The pool that runs the tasks.
+     */
+    taskGroup(threadPool& pool);
+
+    /*! \brief Run a task as part of the group.
+     * 
+     *  \param task The task.
+     */
+    void run(const std::function<void()>& task);
+
+    /*! \brief Wait until all tasks of the group have finished. */
+    void wait();
+};
+
+#endif // THREADPOOL_H